@@ -11,3 +11,5 @@ set Libraries=
 set ProjectName=emulator
 set Code=src/main.c
 set FullCode=%Code%
+set HeadlessProjectName=emulator_headless
+set HeadlessCode=src/headless.c
@@ -0,0 +1,12 @@
+#!/bin/sh
+# NOTE: Headless runner only, the windowed build is Windows-only for now (see build.bat)
+set -e
+cc=${cc:-cc}
+Includes="-Iinclude -Iexternal"
+DebugFlags="-g -O2"
+Libraries=""
+HeadlessProjectName=emulator_headless
+HeadlessCode=src/headless.c
+$cc $HeadlessCode $DebugFlags -DCHECKS=1 $Includes -o $HeadlessProjectName $Libraries
+$cc $HeadlessCode $DebugFlags -DCHECKS=1 -DPROFILE=1 $Includes -o ${HeadlessProjectName}_profile $Libraries
+$cc src/trace_dump.c $DebugFlags -DCHECKS=1 $Includes -o trace_dump $Libraries
@@ -1,3 +1,6 @@
 @echo off
 call _prepare-build.bat
 call %cc% %FullCode% %DebugFlags% -DCHECKS=1 %Includes% -Fe%ProjectName%.exe %Libraries%
+call %cc% %HeadlessCode% %DebugFlags% -DCHECKS=1 %Includes% -Fe%HeadlessProjectName%.exe
+call %cc% %HeadlessCode% %DebugFlags% -DCHECKS=1 -DPROFILE=1 %Includes% -Fe%HeadlessProjectName%_profile.exe
+call %cc% src/trace_dump.c %DebugFlags% -DCHECKS=1 %Includes% -Fetrace_dump.exe
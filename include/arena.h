@@ -0,0 +1,219 @@
+#ifndef _COMMON_ARENA_H
+#define _COMMON_ARENA_H
+
+#include "base.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if CHECKS
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#endif
+
+/*
+
+    Arena allocator. One block, allocations bump a pointer, nothing is freed
+    on its own. ArenaMark/ArenaReset give scopes: everything pushed after the
+    mark goes away on reset. A scratch arena is reset at the start of every
+    frame (ArenaBeginFrame) and holds what only lives for that frame, like
+    formatted debug text.
+
+    Checked builds put PROT_NONE guard pages before and after the block so
+    running off either end traps right there, and fill reset memory with
+    ArenaResetFill so use after reset shows up.
+
+    Nothing is printed, ArenaGetStats returns the numbers.
+
+*/
+
+#define ArenaDefaultAlignment (16)
+#define ArenaResetFill        (0xCD)
+
+typedef struct memory_arena {
+    u8* Base;
+    size_t Size;
+    size_t Used;
+    // NOTE: Stats
+    size_t HighWater;
+    size_t FrameHighWater;
+    u64 AllocationCount;
+    u64 FrameCount;
+#if CHECKS
+    u8* Mapping;
+    size_t MappingSize;
+#endif
+} memory_arena;
+
+typedef struct arena_mark {
+    size_t Used;
+} arena_mark;
+
+typedef struct arena_stats {
+    size_t Size;
+    size_t Used;
+    size_t HighWater;
+    // NOTE: Most used by a single frame, scratch arenas only
+    size_t FrameHighWater;
+    u64 AllocationCount;
+} arena_stats;
+
+#define ArenaPushStruct(Arena, Type) ((Type*)ArenaPush((Arena), sizeof(Type), ArenaDefaultAlignment))
+#define ArenaPushArray(Arena, Type, Count) ((Type*)ArenaPush((Arena), sizeof(Type) * (Count), ArenaDefaultAlignment))
+
+#if CHECKS
+
+internal size_t
+ArenaPageSize(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+    return (size_t)SystemInfo.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+#endif
+
+internal memory_arena
+ArenaInit(size_t Size) {
+    memory_arena Result = {0};
+#if CHECKS
+    size_t PageSize = ArenaPageSize();
+    size_t BlockSize = (Size + PageSize - 1) & ~(PageSize - 1);
+    Result.MappingSize = BlockSize + (2 * PageSize);
+#if defined(_WIN32)
+    Result.Mapping = (u8*)VirtualAlloc(0, Result.MappingSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (Result.Mapping) {
+        DWORD OldProtect;
+        VirtualProtect(Result.Mapping, PageSize, PAGE_NOACCESS, &OldProtect);
+        VirtualProtect(Result.Mapping + PageSize + BlockSize, PageSize, PAGE_NOACCESS, &OldProtect);
+    }
+#else
+    void* Mapping = mmap(0, Result.MappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    Result.Mapping = (Mapping == MAP_FAILED) ? 0 : (u8*)Mapping;
+    if (Result.Mapping) {
+        mprotect(Result.Mapping, PageSize, PROT_NONE);
+        mprotect(Result.Mapping + PageSize + BlockSize, PageSize, PROT_NONE);
+    }
+#endif
+    if (!Result.Mapping) {
+        Halt("Can't map arena");
+        return Result;
+    }
+    // NOTE: Block ends at the guard page, less the few bytes that keep Base
+    //       at ArenaDefaultAlignment
+    Result.Base = Result.Mapping + PageSize + ((BlockSize - Size) & ~(size_t)(ArenaDefaultAlignment - 1));
+#else
+    Result.Base = (u8*)malloc(Size);
+    if (!Result.Base) {
+        Halt("Can't allocate arena");
+        return Result;
+    }
+#endif
+    Result.Size = Size;
+    return Result;
+}
+
+internal void
+ArenaFree(memory_arena* Arena) {
+#if CHECKS
+    if (Arena->Mapping) {
+#if defined(_WIN32)
+        VirtualFree(Arena->Mapping, 0, MEM_RELEASE);
+#else
+        munmap(Arena->Mapping, Arena->MappingSize);
+#endif
+    }
+#else
+    free(Arena->Base);
+#endif
+    memset(Arena, 0, sizeof(*Arena));
+}
+
+// NOTE: Alignment has to be a power of two. Alignment is relative to the
+//       address, not the arena start.
+internal void*
+ArenaPush(memory_arena* Arena, size_t Size, size_t Alignment) {
+    size_t Address = (size_t)(Arena->Base + Arena->Used);
+    size_t Padding = (Alignment - (Address & (Alignment - 1))) & (Alignment - 1);
+    if (Arena->Size - Arena->Used < Size + Padding) {
+        Halt("No space left!");
+        return 0;
+    }
+
+    void* Result = Arena->Base + Arena->Used + Padding;
+    Arena->Used += Size + Padding;
+    Arena->AllocationCount++;
+    if (Arena->Used > Arena->HighWater) {
+        Arena->HighWater = Arena->Used;
+    }
+    return Result;
+}
+
+internal arena_mark
+ArenaMark(memory_arena* Arena) {
+    arena_mark Result;
+    Result.Used = Arena->Used;
+    return Result;
+}
+
+internal void
+ArenaReset(memory_arena* Arena, arena_mark Mark) {
+    Assert(Mark.Used <= Arena->Used);
+#if CHECKS
+    memset(Arena->Base + Mark.Used, ArenaResetFill, Arena->Used - Mark.Used);
+#endif
+    Arena->Used = Mark.Used;
+}
+
+// NOTE: Empties a scratch arena for the next frame
+internal void
+ArenaBeginFrame(memory_arena* Arena) {
+    if (Arena->Used > Arena->FrameHighWater) {
+        Arena->FrameHighWater = Arena->Used;
+    }
+    arena_mark Empty = {0};
+    ArenaReset(Arena, Empty);
+    Arena->FrameCount++;
+}
+
+internal arena_stats
+ArenaGetStats(memory_arena* Arena) {
+    arena_stats Result;
+    Result.Size = Arena->Size;
+    Result.Used = Arena->Used;
+    Result.HighWater = Arena->HighWater;
+    Result.FrameHighWater = (Arena->Used > Arena->FrameHighWater) ? Arena->Used : Arena->FrameHighWater;
+    Result.AllocationCount = Arena->AllocationCount;
+    return Result;
+}
+
+// NOTE: sprintf into the arena, sized to fit. Meant for the scratch arena.
+internal u8*
+ArenaPrintf(memory_arena* Arena, char* Format, ...) {
+    va_list Arguments;
+    va_start(Arguments, Format);
+    i32 Length = vsnprintf(0, 0, Format, Arguments);
+    va_end(Arguments);
+    if (Length < 0) {
+        Length = 0;
+    }
+
+    u8* Result = (u8*)ArenaPush(Arena, (size_t)Length + 1, 1);
+    if (Result) {
+        va_start(Arguments, Format);
+        vsnprintf((char*)Result, (size_t)Length + 1, Format, Arguments);
+        va_end(Arguments);
+    }
+    return Result;
+}
+
+#endif
@@ -35,6 +35,9 @@ typedef double f64;
 void
 PlatformPrint(char* message, ...);
 
+u64
+PlatformTimeNanoseconds(void);
+
 #define ArrayCount(Array) (sizeof(Array) / sizeof(Array[0]))
 
 #define Kilobytes(Value) (Value * 1024)
@@ -0,0 +1,112 @@
+#ifndef _EMU_BATTERY_SAVE_H
+#define _EMU_BATTERY_SAVE_H
+
+#include "base.h"
+#include "emu_types.h"
+#include "bus.h"
+#include "emulator.h"
+#include "file_io.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+
+    Battery-backed PRG-RAM. The .sav file next to the ROM is mapped shared
+    and writable and the bus points $6000-$7FFF straight at it, so every
+    game write lands in the file's pages with no copy. Machine->PrgRam is
+    left unused, save states copy the window in and out (save_state.h).
+
+    A crash of the emulator loses nothing, the pages belong to the file.
+    What is left is the OS writing them back, BatterySaveUpdate asks for
+    that every FlushInterval so an OS crash or power loss costs at most a
+    few seconds. MS_ASYNC only queues the writes, the frame never waits on
+    the disk.
+
+*/
+
+#define BatterySaveFlushInterval (2ULL * 1000000000ULL)
+#define BatterySaveMaxPathLength (1024)
+
+typedef struct battery_save {
+    loaded_file File;
+    u64 LastFlush;
+    u64 FlushCount;
+} battery_save;
+
+// NOTE: RomPath with its extension replaced by .sav
+internal bool32
+BatterySavePath(char* Destination, size_t Capacity, char* RomPath) {
+    size_t Length = strlen(RomPath);
+    size_t Extension = Length;
+    for (size_t Index = Length; Index > 0; Index--) {
+        char Char = RomPath[Index - 1];
+        if (Char == '/' || Char == '\\') {
+            break;
+        }
+        if (Char == '.') {
+            Extension = Index - 1;
+            break;
+        }
+    }
+    if (Extension + sizeof(".sav") > Capacity) {
+        return 0;
+    }
+    memcpy(Destination, RomPath, Extension);
+    memcpy(Destination + Extension, ".sav", sizeof(".sav"));
+    return 1;
+}
+
+// NOTE: After MachineInit, before BusMapMemory. Does nothing for ROMs
+//       without a battery. Returns 0 when the ROM has one but the .sav can't
+//       be mapped or is larger than PRG-RAM, PRG-RAM then stays in the
+//       machine and is not kept.
+internal bool32
+BatterySaveOpen(battery_save* Battery, char* RomPath, bus* Bus) {
+    memset(Battery, 0, sizeof(*Battery));
+    if (!Bus->Rom->HasBattery || !Bus->PrgRam) {
+        return 1;
+    }
+
+    char SavePath[BatterySaveMaxPathLength];
+    if (!BatterySavePath(SavePath, sizeof(SavePath), RomPath)) {
+        return 0;
+    }
+    Battery->File = MapFileWritable(SavePath, PrgRamSize);
+    if (!Battery->File.Data) {
+        return 0;
+    }
+    Bus->PrgRam = Battery->File.Data;
+    Battery->LastFlush = PlatformTimeNanoseconds();
+    return 1;
+}
+
+// NOTE: Call once per frame, flushes when FlushInterval has passed
+internal void
+BatterySaveUpdate(battery_save* Battery) {
+    if (!Battery->File.Data) {
+        return;
+    }
+    u64 Now = PlatformTimeNanoseconds();
+    if (Now - Battery->LastFlush >= BatterySaveFlushInterval) {
+        FlushMappedFile(&Battery->File, 0);
+        Battery->LastFlush = Now;
+        Battery->FlushCount++;
+    }
+}
+
+// NOTE: Points the bus back at the machine's PRG-RAM (with the same
+//       contents) so the machine can keep running
+internal void
+BatterySaveClose(battery_save* Battery, machine_state* Machine, bus* Bus) {
+    if (!Battery->File.Data) {
+        return;
+    }
+    memcpy(Machine->PrgRam, Battery->File.Data, PrgRamSize);
+    Bus->PrgRam = Machine->PrgRam;
+    BusMapMemory(Bus);
+    FlushMappedFile(&Battery->File, 1);
+    UnmapFile(&Battery->File);
+}
+
+#endif
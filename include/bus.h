@@ -6,6 +6,7 @@
 #include "emu_types.h"
 #include "rom.h"
 #include "ppu.h"
+#include "mapper.h"
 
 // NOTE: PPUCTRL bits
 #define NmiEnable            (0b10000000)
@@ -17,58 +18,146 @@
 #define NametableSelect      (0b00000011)
 
 internal u8
-BusRead(bus* Bus, u16 Address) {
-    if (Address >= 0x0000 && Address <= 0x07FF) {
-        //TODO: Mirror RAM
-        return Bus->Ram[Address];
-    } else if (Address >= 0x8000 && Address <= 0xFFFF) {
-        //Mapper space
-        Assert(Bus->Rom->MapperId == MapperNROM);
-        //TODO: Mapper should work here! For now: NROM only
-
-        u16 BaseAddress = Address - 0x8000;
-
-        if (Bus->Rom->PrgRomBankCount == 2) {
-            return Bus->Rom->Prg[BaseAddress];
-        } else if (Bus->Rom->PrgRomBankCount == 1) {
-            if (BaseAddress > PrgBankSize) {
-                BaseAddress -= PrgBankSize;
-                return Bus->Rom->Prg[BaseAddress];
-            } else {
-                return Bus->Rom->Prg[BaseAddress];
-            }
+BusOpenBusRead(bus* Bus, u16 Address) {
+    Unused(Bus);
+    Unused(Address);
+    return 0x00;
+}
+
+internal void
+BusApuWrite(bus* Bus, u16 Address, u8 Value) {
+    Unused(Bus);
+    if (Address > 0x4017) {
+        MemoryAccessTrap(Address, Value, "Unexpected writing");
+    }
+    // APU I/O
+}
+
+internal void
+BusUnmappedWrite(bus* Bus, u16 Address, u8 Value) {
+    Unused(Bus);
+    MemoryAccessTrap(Address, Value, "Unexpected writing");
+}
+
+internal void
+BusMapPage(bus* Bus, u8 Page,
+           u8* Read, u8* Write,
+           bus_read_handler* ReadHandler,
+           bus_write_handler* WriteHandler) {
+    Bus->Pages[Page].Read = Read;
+    Bus->Pages[Page].Write = Write;
+    Bus->Pages[Page].ReadHandler = ReadHandler;
+    Bus->Pages[Page].WriteHandler = WriteHandler;
+}
+
+// NOTE: Has to be called again whenever Ram or Rom change, bank switches
+//       only go through MapperMapMemory
+internal void
+BusMapMemory(bus* Bus) {
+    // RAM, mirrored every 2KB up to $1FFF
+    for (u32 Page = 0x00; Page <= 0x1F; Page++) {
+        u8* RamPage = Bus->Ram + ((Page * BusPageSize) % RamSize);
+        BusMapPage(Bus, (u8)Page, RamPage, RamPage, 0, 0);
+    }
+
+    for (u32 Page = 0x20; Page <= 0x3F; Page++) {
+        BusMapPage(Bus, (u8)Page, 0, 0, PpuRegisterRead, PpuRegisterWrite);
+    }
+
+    BusMapPage(Bus, 0x40, 0, 0, BusOpenBusRead, BusApuWrite);
+
+    for (u32 Page = 0x41; Page <= 0x5F; Page++) {
+        BusMapPage(Bus, (u8)Page, 0, 0, BusOpenBusRead, BusUnmappedWrite);
+    }
+
+    // PRG-RAM
+    for (u32 Page = 0x60; Page <= 0x7F; Page++) {
+        if (Bus->PrgRam) {
+            u8* PrgRamPage = Bus->PrgRam + ((Page - 0x60) * BusPageSize);
+            BusMapPage(Bus, (u8)Page, PrgRamPage, PrgRamPage, 0, 0);
         } else {
-            MemoryAccessTrap(Address, 0x00, "Not sure, need debugging.");
+            BusMapPage(Bus, (u8)Page, 0, 0, BusOpenBusRead, BusUnmappedWrite);
         }
-    } else if (Address >= PpuRegisterAddressStart && Address <= PpuRegisterAddressEnd) {
-        return PpuRegisterRead(Bus, Address);
     }
 
+    // Mapper space, the mapper points the pages at the selected banks
+    for (u32 Page = 0x80; Page <= 0xFF; Page++) {
+        u8* Read = Bus->Pages[Page].Read;
+        BusMapPage(Bus, (u8)Page, Read, 0, 0, MapperWrite);
+    }
+    MapperMapMemory(Bus);
+}
+
+internal u8
+BusRead(bus* Bus, u16 Address) {
+    bus_page* Page = Bus->Pages + (Address >> 8);
+    if (Page->Read) {
+        return Page->Read[Address & 0xFF];
+    }
+    return Page->ReadHandler(Bus, Address);
+}
+
+// NOTE: Debugger read, no side effects. I/O registers read as 0.
+internal u8
+BusPeek(bus* Bus, u16 Address) {
+    bus_page* Page = Bus->Pages + (Address >> 8);
+    if (Page->Read) {
+        return Page->Read[Address & 0xFF];
+    }
     return 0x00;
 }
 
 internal void
 BusWrite(bus* Bus, u16 Address, u8 Value) {
-    if (Address >= PpuRegisterAddressStart && Address <= PpuRegisterAddressEnd) {
-        PpuRegisterWrite(Bus, Address, Value);
-    } else if (Address >= 0x0000 && Address <= 0X1FFF) {
-        // RAM
-        u16 RamBaseAddress = Address % RamSize;
-        Bus->Ram[RamBaseAddress] = Value;
-    } else if (Address >= 0x4000 && Address <= 0X4017) {
-        // APU I/O
+    bus_page* Page = Bus->Pages + (Address >> 8);
+    if (Page->Write) {
+        Page->Write[Address & 0xFF] = Value;
     } else {
-        MemoryAccessTrap(Address, Value, "Unexpected writing");
+        Page->WriteHandler(Bus, Address, Value);
+    }
+}
+
+#define CodeDataLogSize(Rom) (RamSize + PrgRamSize + ((Rom)->PrgRomBankCount * PrgBankSize))
+
+// NOTE: Code/data log entry of the memory Address is mapped to now: RAM,
+//       then PRG-RAM, then PRG-ROM. -1 for I/O and unmapped pages.
+internal i32
+CodeDataLogOffset(bus* Bus, u16 Address) {
+    u8* Memory = Bus->Pages[Address >> 8].Read;
+    if (!Memory) {
+        return -1;
+    }
+    Memory += Address & 0xFF;
+    u8* Prg = Bus->Rom->Prg;
+    if (Memory >= Bus->Ram && Memory < Bus->Ram + RamSize) {
+        return (i32)(Memory - Bus->Ram);
+    }
+    if (Bus->PrgRam && Memory >= Bus->PrgRam && Memory < Bus->PrgRam + PrgRamSize) {
+        return RamSize + (i32)(Memory - Bus->PrgRam);
+    }
+    if (Memory >= Prg && Memory < Prg + (Bus->Rom->PrgRomBankCount * PrgBankSize)) {
+        return RamSize + PrgRamSize + (i32)(Memory - Prg);
+    }
+    return -1;
+}
+
+internal void
+BusLogCode(bus* Bus, u16 Address) {
+    i32 Offset = CodeDataLogOffset(Bus, Address);
+    if (Offset >= 0) {
+        Bus->CodeDataLog[Offset] |= CodeDataLogCode;
     }
 }
 
 internal void
 BusPostRead(bus* Bus, u16 Address) {
     if (Address >= PpuRegisterAddressStart && Address <= PpuRegisterAddressEnd) {
-        u16 PpuRegister = (Address - PpuRegisterAddressStart) % PpuRegisterCount;
+        u16 PpuRegister = Address & (PpuRegisterCount - 1);
         if (PpuRegister == PPUSTATUS) {
+            PpuCatchUpToCpu(Bus);
             Bus->Ppu->Status.VerticalBlank = 0;
             Bus->Ppu->AddressLatch = 0;
+            PpuUpdateNmiOutput(Bus);
         } else if (PpuRegister == PPUMASK) {
         } else if (PpuRegister == PPUSTATUS) {
         } else if (PpuRegister == OAMADDR) {
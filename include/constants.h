@@ -15,6 +15,13 @@
 #define PPUDATA   (0x0007)
 #define OAMDMA    (0x4014)
 
+// NOTE: CPU runs at a third of the PPU dot clock
+#define CpuClockDivider (3)
+
+#define NmiVector   (0xFFFA)
+#define ResetVector (0xFFFC)
+#define IrqVector   (0xFFFE)
+
 #define NametableTileSize            (8)
 #define NametableTileRowCount        (30)
 #define NametableTileTilePerRowCount (32)
@@ -0,0 +1,625 @@
+#ifndef _EMU_CPU_FAST_H
+#define _EMU_CPU_FAST_H
+
+#include "base.h"
+#include "constants.h"
+#include "emu_types.h"
+#include "bus.h"
+#include "trace.h"
+
+#include "m6502.h"
+
+/*
+
+    Instruction-stepped 6502 core for bulk runs (batch tests, fast-forward).
+
+    Runs a whole instruction per FastCpuStep call. No decimal mode (NES 2A03).
+    Registers live in the same m6502_t as the accurate core so the debug view
+    does not care which one runs. Every cycle still advances the clock by
+    CpuClockDivider, memory accesses happen on the same cycle as on the real
+    chip. Dummy accesses that can reach I/O or a mapper are made like m6502
+    makes them: the read of the un-carried address by indexed modes and the
+    write of the unmodified value by read-modify-write instructions. Other
+    internal and dummy cycles (stack, zero page, PC) only count time.
+
+*/
+
+typedef struct fast_cpu {
+    m6502_t* Cpu;
+    bus* Bus;
+    u64 Clock;
+} fast_cpu;
+
+internal u8
+FastCpuRead(fast_cpu* Fast, u16 Address) {
+    bus* Bus = Fast->Bus;
+    bus_page* Page = Bus->Pages + (Address >> 8);
+    u8 Result;
+    if (Page->Read) {
+        Result = Page->Read[Address & 0xFF];
+    } else {
+        Bus->Scheduler.MasterClock = Fast->Clock;
+        Result = Page->ReadHandler(Bus, Address);
+        BusPostRead(Bus, Address);
+    }
+    Fast->Clock += CpuClockDivider;
+    return Result;
+}
+
+internal void
+FastCpuWrite(fast_cpu* Fast, u16 Address, u8 Value) {
+    bus* Bus = Fast->Bus;
+    bus_page* Page = Bus->Pages + (Address >> 8);
+    if (Page->Write) {
+        Page->Write[Address & 0xFF] = Value;
+    } else {
+        Bus->Scheduler.MasterClock = Fast->Clock;
+        Page->WriteHandler(Bus, Address, Value);
+    }
+    Fast->Clock += CpuClockDivider;
+}
+
+#define FastCpuIdle(Fast) ((Fast)->Clock += CpuClockDivider)
+
+internal u8
+FastCpuFetch(fast_cpu* Fast) {
+    return FastCpuRead(Fast, Fast->Cpu->PC++);
+}
+
+internal void
+FastCpuPush(fast_cpu* Fast, u8 Value) {
+    FastCpuWrite(Fast, 0x0100 | Fast->Cpu->S, Value);
+    Fast->Cpu->S--;
+}
+
+internal u8
+FastCpuPull(fast_cpu* Fast) {
+    Fast->Cpu->S++;
+    return FastCpuRead(Fast, 0x0100 | Fast->Cpu->S);
+}
+
+internal void
+FastCpuSetNZ(m6502_t* Cpu, u8 Value) {
+    Cpu->P = (Cpu->P & ~(M6502_NF | M6502_ZF)) | (Value ? (Value & M6502_NF) : M6502_ZF);
+}
+
+internal void
+FastCpuSetFlag(m6502_t* Cpu, u8 Flag, bool32 Set) {
+    Cpu->P = Set ? (Cpu->P | Flag) : (Cpu->P & ~Flag);
+}
+
+// NOTE: Addressing modes, each consumes the cycles needed to form the address.
+//       Write and read-modify-write accesses always pay the index penalty.
+
+internal u16
+FastCpuAddrZeroPage(fast_cpu* Fast) {
+    return FastCpuFetch(Fast);
+}
+
+internal u16
+FastCpuAddrZeroPageIndexed(fast_cpu* Fast, u8 Index) {
+    u8 Base = FastCpuFetch(Fast);
+    FastCpuIdle(Fast);
+    return (u8)(Base + Index);
+}
+
+internal u16
+FastCpuAddrAbsolute(fast_cpu* Fast) {
+    u16 Low = FastCpuFetch(Fast);
+    u16 High = FastCpuFetch(Fast);
+    return (High << 8) | Low;
+}
+
+// NOTE: The penalty cycle reads the address before the carry went into the
+//       high byte, which is an I/O read when it lands on $2002 or $2007
+internal u16
+FastCpuAddrAbsoluteIndexed(fast_cpu* Fast, u8 Index, bool32 AlwaysPenalty) {
+    u16 Base = FastCpuAddrAbsolute(Fast);
+    u16 Result = Base + Index;
+    if (AlwaysPenalty || ((Base ^ Result) & 0xFF00)) {
+        FastCpuRead(Fast, (Base & 0xFF00) | (Result & 0x00FF));
+    }
+    return Result;
+}
+
+internal u16
+FastCpuAddrIndirectX(fast_cpu* Fast) {
+    u8 Pointer = FastCpuFetch(Fast);
+    FastCpuIdle(Fast);
+    Pointer += Fast->Cpu->X;
+    u16 Low = FastCpuRead(Fast, Pointer);
+    u16 High = FastCpuRead(Fast, (u8)(Pointer + 1));
+    return (High << 8) | Low;
+}
+
+internal u16
+FastCpuAddrIndirectY(fast_cpu* Fast, bool32 AlwaysPenalty) {
+    u8 Pointer = FastCpuFetch(Fast);
+    u16 Low = FastCpuRead(Fast, Pointer);
+    u16 High = FastCpuRead(Fast, (u8)(Pointer + 1));
+    u16 Base = (High << 8) | Low;
+    u16 Result = Base + Fast->Cpu->Y;
+    if (AlwaysPenalty || ((Base ^ Result) & 0xFF00)) {
+        FastCpuRead(Fast, (Base & 0xFF00) | (Result & 0x00FF));
+    }
+    return Result;
+}
+
+// NOTE: ALU
+
+internal void
+FastCpuAdc(m6502_t* Cpu, u8 Value) {
+    u16 Sum = Cpu->A + Value + (Cpu->P & M6502_CF);
+    FastCpuSetFlag(Cpu, M6502_VF, (~(Cpu->A ^ Value) & (Cpu->A ^ Sum)) & 0x80);
+    FastCpuSetFlag(Cpu, M6502_CF, Sum > 0xFF);
+    Cpu->A = (u8)Sum;
+    FastCpuSetNZ(Cpu, Cpu->A);
+}
+
+internal void
+FastCpuCompare(m6502_t* Cpu, u8 Register, u8 Value) {
+    FastCpuSetFlag(Cpu, M6502_CF, Register >= Value);
+    FastCpuSetNZ(Cpu, (u8)(Register - Value));
+}
+
+internal u8
+FastCpuAsl(m6502_t* Cpu, u8 Value) {
+    FastCpuSetFlag(Cpu, M6502_CF, Value & 0x80);
+    Value <<= 1;
+    FastCpuSetNZ(Cpu, Value);
+    return Value;
+}
+
+internal u8
+FastCpuLsr(m6502_t* Cpu, u8 Value) {
+    FastCpuSetFlag(Cpu, M6502_CF, Value & 0x01);
+    Value >>= 1;
+    FastCpuSetNZ(Cpu, Value);
+    return Value;
+}
+
+internal u8
+FastCpuRol(m6502_t* Cpu, u8 Value) {
+    u8 Carry = Cpu->P & M6502_CF;
+    FastCpuSetFlag(Cpu, M6502_CF, Value & 0x80);
+    Value = (Value << 1) | Carry;
+    FastCpuSetNZ(Cpu, Value);
+    return Value;
+}
+
+internal u8
+FastCpuRor(m6502_t* Cpu, u8 Value) {
+    u8 Carry = (Cpu->P & M6502_CF) << 7;
+    FastCpuSetFlag(Cpu, M6502_CF, Value & 0x01);
+    Value = (Value >> 1) | Carry;
+    FastCpuSetNZ(Cpu, Value);
+    return Value;
+}
+
+internal void
+FastCpuBit(m6502_t* Cpu, u8 Value) {
+    FastCpuSetFlag(Cpu, M6502_ZF, !(Cpu->A & Value));
+    Cpu->P = (Cpu->P & ~(M6502_NF | M6502_VF)) | (Value & (M6502_NF | M6502_VF));
+}
+
+internal void
+FastCpuBranch(fast_cpu* Fast, bool32 Condition) {
+    i8 Offset = (i8)FastCpuFetch(Fast);
+    if (Condition) {
+        u16 Target = Fast->Cpu->PC + Offset;
+        FastCpuIdle(Fast);
+        if ((Target ^ Fast->Cpu->PC) & 0xFF00) {
+            FastCpuIdle(Fast);
+        } else {
+            Fast->Bus->Scheduler.FastCpuBranchClock = Fast->Clock;
+        }
+        Fast->Cpu->PC = Target;
+    }
+}
+
+internal void
+FastCpuInterrupt(fast_cpu* Fast, u16 Vector, bool32 Break) {
+    m6502_t* Cpu = Fast->Cpu;
+    FastCpuPush(Fast, Cpu->PC >> 8);
+    FastCpuPush(Fast, (u8)Cpu->PC);
+    u8 PushedP = Cpu->P | M6502_XF;
+    if (!Break) {
+        PushedP &= ~M6502_BF;
+    }
+    FastCpuPush(Fast, PushedP);
+    Cpu->P |= (M6502_IF | M6502_BF);
+    u16 Low = FastCpuRead(Fast, Vector);
+    u16 High = FastCpuRead(Fast, Vector + 1);
+    Cpu->PC = (High << 8) | Low;
+}
+
+
+// NOTE: Same end state as the m6502 reset sequence, first opcode fetch
+//       happens on the 7th CPU cycle.
+internal void
+FastCpuReset(m6502_t* Cpu, bus* Bus) {
+    fast_cpu Fast;
+    Fast.Cpu = Cpu;
+    Fast.Bus = Bus;
+    Fast.Clock = Bus->Scheduler.MasterClock;
+
+    Cpu->S = 0xFD;
+    Cpu->P = (Cpu->P | M6502_IF | M6502_BF) & ~M6502_XF;
+    Fast.Clock += 4 * CpuClockDivider;
+    u16 Low = FastCpuRead(&Fast, ResetVector);
+    u16 High = FastCpuRead(&Fast, ResetVector + 1);
+    Cpu->PC = (High << 8) | Low;
+
+    Bus->Scheduler.MasterClock = Fast.Clock;
+}
+
+#define FastCpuLoad(Register, Address)  { Cpu->Register = FastCpuRead(&Fast, (Address)); FastCpuSetNZ(Cpu, Cpu->Register); }
+#define FastCpuStore(Register, Address) { u16 StoreAddress = (Address); FastCpuWrite(&Fast, StoreAddress, Cpu->Register); }
+#define FastCpuAlu(Operation, Address)  { u8 Operand = FastCpuRead(&Fast, (Address)); Operation; }
+#define FastCpuModify(Operation, Address) {\
+    u16 ModifyAddress = (Address);\
+    u8 Value = FastCpuRead(&Fast, ModifyAddress);\
+    FastCpuWrite(&Fast, ModifyAddress, Value);\
+    Value = Operation;\
+    FastCpuWrite(&Fast, ModifyAddress, Value);\
+}\
+
+// NOTE: Unstable opcodes (ANE, LXA, SHA, SHX, SHY, TAS) use the common 0xEE magic
+#define FastCpuUnstableMagic (0xEE)
+
+internal u16
+FastCpuHighPlusOne(u16 Address) {
+    return (u16)((Address >> 8) + 1);
+}
+
+// NOTE: Executes one instruction, or the interrupt sequence if one is due,
+//       and moves Bus->Scheduler.MasterClock to the next CPU cycle.
+internal void
+FastCpuStep(m6502_t* Cpu, bus* Bus) {
+    fast_cpu Fast;
+    Fast.Cpu = Cpu;
+    Fast.Bus = Bus;
+    Fast.Clock = Bus->Scheduler.MasterClock;
+
+    // NOTE: The edge has to be seen one cycle before the opcode fetch, two
+    //       after a taken branch that did not cross a page
+    ppu* Ppu = Bus->Ppu;
+    u64 NmiLatency = CpuClockDivider;
+    if (Bus->Scheduler.FastCpuBranchClock == Fast.Clock) {
+        NmiLatency += CpuClockDivider;
+    }
+    if (Ppu->NmiPending && (Ppu->NmiDot + NmiLatency) <= Fast.Clock) {
+        Ppu->NmiPending = 0;
+        FastCpuIdle(&Fast);
+        FastCpuIdle(&Fast);
+        FastCpuInterrupt(&Fast, NmiVector, 0);
+        Bus->Scheduler.MasterClock = Fast.Clock;
+        return;
+    }
+
+    // NOTE: IRQ is a level, seen the same cycle before the fetch as NMI
+    mapper* Mapper = Bus->Mapper;
+    u8 IrqFlag = Cpu->P & M6502_IF;
+    if (Bus->Scheduler.FastCpuIrqFlagClock == Fast.Clock) {
+        IrqFlag = Bus->Scheduler.FastCpuIrqFlag;
+    }
+    if (Mapper->IrqLine && !IrqFlag && (Mapper->IrqClock + CpuClockDivider) <= Fast.Clock) {
+        FastCpuIdle(&Fast);
+        FastCpuIdle(&Fast);
+        FastCpuInterrupt(&Fast, IrqVector, 0);
+        Bus->Scheduler.MasterClock = Fast.Clock;
+        return;
+    }
+
+    if (Bus->CodeDataLog) {
+        BusLogCode(Bus, Cpu->PC);
+    }
+    if (Bus->Trace) {
+        TraceInstruction(Bus->Trace, Bus, Cpu, Cpu->PC);
+    }
+    u8 OpCode = FastCpuFetch(&Fast);
+    u8 IrqFlagBefore = Cpu->P & M6502_IF;
+
+    switch (OpCode) {
+        // NOTE: Loads
+        case 0xA9: FastCpuLoad(A, Cpu->PC++); break;
+        case 0xA5: FastCpuLoad(A, FastCpuAddrZeroPage(&Fast)); break;
+        case 0xB5: FastCpuLoad(A, FastCpuAddrZeroPageIndexed(&Fast, Cpu->X)); break;
+        case 0xAD: FastCpuLoad(A, FastCpuAddrAbsolute(&Fast)); break;
+        case 0xBD: FastCpuLoad(A, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->X, 0)); break;
+        case 0xB9: FastCpuLoad(A, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 0)); break;
+        case 0xA1: FastCpuLoad(A, FastCpuAddrIndirectX(&Fast)); break;
+        case 0xB1: FastCpuLoad(A, FastCpuAddrIndirectY(&Fast, 0)); break;
+
+        case 0xA2: FastCpuLoad(X, Cpu->PC++); break;
+        case 0xA6: FastCpuLoad(X, FastCpuAddrZeroPage(&Fast)); break;
+        case 0xB6: FastCpuLoad(X, FastCpuAddrZeroPageIndexed(&Fast, Cpu->Y)); break;
+        case 0xAE: FastCpuLoad(X, FastCpuAddrAbsolute(&Fast)); break;
+        case 0xBE: FastCpuLoad(X, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 0)); break;
+
+        case 0xA0: FastCpuLoad(Y, Cpu->PC++); break;
+        case 0xA4: FastCpuLoad(Y, FastCpuAddrZeroPage(&Fast)); break;
+        case 0xB4: FastCpuLoad(Y, FastCpuAddrZeroPageIndexed(&Fast, Cpu->X)); break;
+        case 0xAC: FastCpuLoad(Y, FastCpuAddrAbsolute(&Fast)); break;
+        case 0xBC: FastCpuLoad(Y, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->X, 0)); break;
+
+        // NOTE: Stores
+        case 0x85: FastCpuStore(A, FastCpuAddrZeroPage(&Fast)); break;
+        case 0x95: FastCpuStore(A, FastCpuAddrZeroPageIndexed(&Fast, Cpu->X)); break;
+        case 0x8D: FastCpuStore(A, FastCpuAddrAbsolute(&Fast)); break;
+        case 0x9D: FastCpuStore(A, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->X, 1)); break;
+        case 0x99: FastCpuStore(A, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 1)); break;
+        case 0x81: FastCpuStore(A, FastCpuAddrIndirectX(&Fast)); break;
+        case 0x91: FastCpuStore(A, FastCpuAddrIndirectY(&Fast, 1)); break;
+
+        case 0x86: FastCpuStore(X, FastCpuAddrZeroPage(&Fast)); break;
+        case 0x96: FastCpuStore(X, FastCpuAddrZeroPageIndexed(&Fast, Cpu->Y)); break;
+        case 0x8E: FastCpuStore(X, FastCpuAddrAbsolute(&Fast)); break;
+
+        case 0x84: FastCpuStore(Y, FastCpuAddrZeroPage(&Fast)); break;
+        case 0x94: FastCpuStore(Y, FastCpuAddrZeroPageIndexed(&Fast, Cpu->X)); break;
+        case 0x8C: FastCpuStore(Y, FastCpuAddrAbsolute(&Fast)); break;
+
+        // NOTE: ALU
+        #define FastCpuAluGroup(Base, Operation)\
+        case (Base + 0x09): FastCpuAlu(Operation, Cpu->PC++); break;\
+        case (Base + 0x05): FastCpuAlu(Operation, FastCpuAddrZeroPage(&Fast)); break;\
+        case (Base + 0x15): FastCpuAlu(Operation, FastCpuAddrZeroPageIndexed(&Fast, Cpu->X)); break;\
+        case (Base + 0x0D): FastCpuAlu(Operation, FastCpuAddrAbsolute(&Fast)); break;\
+        case (Base + 0x1D): FastCpuAlu(Operation, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->X, 0)); break;\
+        case (Base + 0x19): FastCpuAlu(Operation, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 0)); break;\
+        case (Base + 0x01): FastCpuAlu(Operation, FastCpuAddrIndirectX(&Fast)); break;\
+        case (Base + 0x11): FastCpuAlu(Operation, FastCpuAddrIndirectY(&Fast, 0)); break;\
+
+        FastCpuAluGroup(0x00, { Cpu->A |= Operand; FastCpuSetNZ(Cpu, Cpu->A); })
+        FastCpuAluGroup(0x20, { Cpu->A &= Operand; FastCpuSetNZ(Cpu, Cpu->A); })
+        FastCpuAluGroup(0x40, { Cpu->A ^= Operand; FastCpuSetNZ(Cpu, Cpu->A); })
+        FastCpuAluGroup(0x60, FastCpuAdc(Cpu, Operand))
+        FastCpuAluGroup(0xC0, FastCpuCompare(Cpu, Cpu->A, Operand))
+        FastCpuAluGroup(0xE0, FastCpuAdc(Cpu, Operand ^ 0xFF))
+
+        #undef FastCpuAluGroup
+
+        case 0xEB: FastCpuAlu(FastCpuAdc(Cpu, Operand ^ 0xFF), Cpu->PC++); break;
+
+        case 0xE0: FastCpuAlu(FastCpuCompare(Cpu, Cpu->X, Operand), Cpu->PC++); break;
+        case 0xE4: FastCpuAlu(FastCpuCompare(Cpu, Cpu->X, Operand), FastCpuAddrZeroPage(&Fast)); break;
+        case 0xEC: FastCpuAlu(FastCpuCompare(Cpu, Cpu->X, Operand), FastCpuAddrAbsolute(&Fast)); break;
+        case 0xC0: FastCpuAlu(FastCpuCompare(Cpu, Cpu->Y, Operand), Cpu->PC++); break;
+        case 0xC4: FastCpuAlu(FastCpuCompare(Cpu, Cpu->Y, Operand), FastCpuAddrZeroPage(&Fast)); break;
+        case 0xCC: FastCpuAlu(FastCpuCompare(Cpu, Cpu->Y, Operand), FastCpuAddrAbsolute(&Fast)); break;
+
+        case 0x24: FastCpuAlu(FastCpuBit(Cpu, Operand), FastCpuAddrZeroPage(&Fast)); break;
+        case 0x2C: FastCpuAlu(FastCpuBit(Cpu, Operand), FastCpuAddrAbsolute(&Fast)); break;
+
+        // NOTE: Read-modify-write
+        #define FastCpuModifyGroup(Base, Operation)\
+        case (Base + 0x06): FastCpuModify(Operation, FastCpuAddrZeroPage(&Fast)); break;\
+        case (Base + 0x16): FastCpuModify(Operation, FastCpuAddrZeroPageIndexed(&Fast, Cpu->X)); break;\
+        case (Base + 0x0E): FastCpuModify(Operation, FastCpuAddrAbsolute(&Fast)); break;\
+        case (Base + 0x1E): FastCpuModify(Operation, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->X, 1)); break;\
+
+        FastCpuModifyGroup(0x00, FastCpuAsl(Cpu, Value))
+        FastCpuModifyGroup(0x20, FastCpuRol(Cpu, Value))
+        FastCpuModifyGroup(0x40, FastCpuLsr(Cpu, Value))
+        FastCpuModifyGroup(0x60, FastCpuRor(Cpu, Value))
+        FastCpuModifyGroup(0xC0, (FastCpuSetNZ(Cpu, (u8)(Value - 1)), (u8)(Value - 1)))
+        FastCpuModifyGroup(0xE0, (FastCpuSetNZ(Cpu, (u8)(Value + 1)), (u8)(Value + 1)))
+
+        #undef FastCpuModifyGroup
+
+        case 0x0A: FastCpuIdle(&Fast); Cpu->A = FastCpuAsl(Cpu, Cpu->A); break;
+        case 0x2A: FastCpuIdle(&Fast); Cpu->A = FastCpuRol(Cpu, Cpu->A); break;
+        case 0x4A: FastCpuIdle(&Fast); Cpu->A = FastCpuLsr(Cpu, Cpu->A); break;
+        case 0x6A: FastCpuIdle(&Fast); Cpu->A = FastCpuRor(Cpu, Cpu->A); break;
+
+        // NOTE: Implied
+        case 0xAA: FastCpuIdle(&Fast); Cpu->X = Cpu->A; FastCpuSetNZ(Cpu, Cpu->X); break;
+        case 0xA8: FastCpuIdle(&Fast); Cpu->Y = Cpu->A; FastCpuSetNZ(Cpu, Cpu->Y); break;
+        case 0x8A: FastCpuIdle(&Fast); Cpu->A = Cpu->X; FastCpuSetNZ(Cpu, Cpu->A); break;
+        case 0x98: FastCpuIdle(&Fast); Cpu->A = Cpu->Y; FastCpuSetNZ(Cpu, Cpu->A); break;
+        case 0xBA: FastCpuIdle(&Fast); Cpu->X = Cpu->S; FastCpuSetNZ(Cpu, Cpu->X); break;
+        case 0x9A: FastCpuIdle(&Fast); Cpu->S = Cpu->X; break;
+        case 0xE8: FastCpuIdle(&Fast); Cpu->X++; FastCpuSetNZ(Cpu, Cpu->X); break;
+        case 0xC8: FastCpuIdle(&Fast); Cpu->Y++; FastCpuSetNZ(Cpu, Cpu->Y); break;
+        case 0xCA: FastCpuIdle(&Fast); Cpu->X--; FastCpuSetNZ(Cpu, Cpu->X); break;
+        case 0x88: FastCpuIdle(&Fast); Cpu->Y--; FastCpuSetNZ(Cpu, Cpu->Y); break;
+        case 0x18: FastCpuIdle(&Fast); Cpu->P &= ~M6502_CF; break;
+        case 0x38: FastCpuIdle(&Fast); Cpu->P |= M6502_CF; break;
+        case 0x58: FastCpuIdle(&Fast); Cpu->P &= ~M6502_IF; break;
+        case 0x78: FastCpuIdle(&Fast); Cpu->P |= M6502_IF; break;
+        case 0xB8: FastCpuIdle(&Fast); Cpu->P &= ~M6502_VF; break;
+        case 0xD8: FastCpuIdle(&Fast); Cpu->P &= ~M6502_DF; break;
+        case 0xF8: FastCpuIdle(&Fast); Cpu->P |= M6502_DF; break;
+
+        case 0x1A: case 0x3A: case 0x5A: case 0x7A: case 0xDA: case 0xEA: case 0xFA:
+            FastCpuIdle(&Fast);
+            break;
+
+        // NOTE: Stack
+        case 0x48: FastCpuIdle(&Fast); FastCpuPush(&Fast, Cpu->A); break;
+        case 0x08: FastCpuIdle(&Fast); FastCpuPush(&Fast, Cpu->P | M6502_XF); break;
+        case 0x68: {
+            FastCpuIdle(&Fast);
+            FastCpuIdle(&Fast);
+            Cpu->A = FastCpuPull(&Fast);
+            FastCpuSetNZ(Cpu, Cpu->A);
+        } break;
+        case 0x28: {
+            FastCpuIdle(&Fast);
+            FastCpuIdle(&Fast);
+            Cpu->P = (FastCpuPull(&Fast) | M6502_BF) & ~M6502_XF;
+        } break;
+
+        // NOTE: Control flow
+        case 0x10: FastCpuBranch(&Fast, !(Cpu->P & M6502_NF)); break;
+        case 0x30: FastCpuBranch(&Fast, (Cpu->P & M6502_NF)); break;
+        case 0x50: FastCpuBranch(&Fast, !(Cpu->P & M6502_VF)); break;
+        case 0x70: FastCpuBranch(&Fast, (Cpu->P & M6502_VF)); break;
+        case 0x90: FastCpuBranch(&Fast, !(Cpu->P & M6502_CF)); break;
+        case 0xB0: FastCpuBranch(&Fast, (Cpu->P & M6502_CF)); break;
+        case 0xD0: FastCpuBranch(&Fast, !(Cpu->P & M6502_ZF)); break;
+        case 0xF0: FastCpuBranch(&Fast, (Cpu->P & M6502_ZF)); break;
+
+        case 0x4C: Cpu->PC = FastCpuAddrAbsolute(&Fast); break;
+        case 0x6C: {
+            u16 Pointer = FastCpuAddrAbsolute(&Fast);
+            u16 Low = FastCpuRead(&Fast, Pointer);
+            // NOTE: Pointer high byte does not carry into the next page
+            u16 High = FastCpuRead(&Fast, (Pointer & 0xFF00) | ((Pointer + 1) & 0x00FF));
+            Cpu->PC = (High << 8) | Low;
+        } break;
+        case 0x20: {
+            u16 Low = FastCpuFetch(&Fast);
+            FastCpuIdle(&Fast);
+            FastCpuPush(&Fast, Cpu->PC >> 8);
+            FastCpuPush(&Fast, (u8)Cpu->PC);
+            u16 High = FastCpuRead(&Fast, Cpu->PC);
+            Cpu->PC = (High << 8) | Low;
+        } break;
+        case 0x60: {
+            FastCpuIdle(&Fast);
+            FastCpuIdle(&Fast);
+            u16 Low = FastCpuPull(&Fast);
+            u16 High = FastCpuPull(&Fast);
+            FastCpuIdle(&Fast);
+            Cpu->PC = ((High << 8) | Low) + 1;
+        } break;
+        case 0x40: {
+            FastCpuIdle(&Fast);
+            FastCpuIdle(&Fast);
+            Cpu->P = (FastCpuPull(&Fast) | M6502_BF) & ~M6502_XF;
+            u16 Low = FastCpuPull(&Fast);
+            u16 High = FastCpuPull(&Fast);
+            Cpu->PC = (High << 8) | Low;
+        } break;
+        case 0x00: {
+            FastCpuIdle(&Fast);
+            Cpu->PC++;
+            FastCpuInterrupt(&Fast, IrqVector, 1);
+        } break;
+
+        // NOTE: Unofficial NOPs still do their reads
+        case 0x80: case 0x82: case 0x89: case 0xC2: case 0xE2:
+            FastCpuRead(&Fast, Cpu->PC++);
+            break;
+        case 0x04: case 0x44: case 0x64:
+            FastCpuRead(&Fast, FastCpuAddrZeroPage(&Fast));
+            break;
+        case 0x14: case 0x34: case 0x54: case 0x74: case 0xD4: case 0xF4:
+            FastCpuRead(&Fast, FastCpuAddrZeroPageIndexed(&Fast, Cpu->X));
+            break;
+        case 0x0C:
+            FastCpuRead(&Fast, FastCpuAddrAbsolute(&Fast));
+            break;
+        case 0x1C: case 0x3C: case 0x5C: case 0x7C: case 0xDC: case 0xFC:
+            FastCpuRead(&Fast, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->X, 0));
+            break;
+
+        // NOTE: Unofficial combined opcodes
+        case 0xA7: FastCpuLoad(A, FastCpuAddrZeroPage(&Fast)); Cpu->X = Cpu->A; break;
+        case 0xB7: FastCpuLoad(A, FastCpuAddrZeroPageIndexed(&Fast, Cpu->Y)); Cpu->X = Cpu->A; break;
+        case 0xAF: FastCpuLoad(A, FastCpuAddrAbsolute(&Fast)); Cpu->X = Cpu->A; break;
+        case 0xBF: FastCpuLoad(A, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 0)); Cpu->X = Cpu->A; break;
+        case 0xA3: FastCpuLoad(A, FastCpuAddrIndirectX(&Fast)); Cpu->X = Cpu->A; break;
+        case 0xB3: FastCpuLoad(A, FastCpuAddrIndirectY(&Fast, 0)); Cpu->X = Cpu->A; break;
+
+        case 0x87: FastCpuWrite(&Fast, FastCpuAddrZeroPage(&Fast), Cpu->A & Cpu->X); break;
+        case 0x97: FastCpuWrite(&Fast, FastCpuAddrZeroPageIndexed(&Fast, Cpu->Y), Cpu->A & Cpu->X); break;
+        case 0x8F: FastCpuWrite(&Fast, FastCpuAddrAbsolute(&Fast), Cpu->A & Cpu->X); break;
+        case 0x83: FastCpuWrite(&Fast, FastCpuAddrIndirectX(&Fast), Cpu->A & Cpu->X); break;
+
+        #define FastCpuComboGroup(Base, Operation)\
+        case (Base + 0x07): FastCpuModify(Operation, FastCpuAddrZeroPage(&Fast)); break;\
+        case (Base + 0x17): FastCpuModify(Operation, FastCpuAddrZeroPageIndexed(&Fast, Cpu->X)); break;\
+        case (Base + 0x0F): FastCpuModify(Operation, FastCpuAddrAbsolute(&Fast)); break;\
+        case (Base + 0x1F): FastCpuModify(Operation, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->X, 1)); break;\
+        case (Base + 0x1B): FastCpuModify(Operation, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 1)); break;\
+        case (Base + 0x03): FastCpuModify(Operation, FastCpuAddrIndirectX(&Fast)); break;\
+        case (Base + 0x13): FastCpuModify(Operation, FastCpuAddrIndirectY(&Fast, 1)); break;\
+
+        FastCpuComboGroup(0x00, (Value = FastCpuAsl(Cpu, Value), Cpu->A |= Value, FastCpuSetNZ(Cpu, Cpu->A), Value))
+        FastCpuComboGroup(0x20, (Value = FastCpuRol(Cpu, Value), Cpu->A &= Value, FastCpuSetNZ(Cpu, Cpu->A), Value))
+        FastCpuComboGroup(0x40, (Value = FastCpuLsr(Cpu, Value), Cpu->A ^= Value, FastCpuSetNZ(Cpu, Cpu->A), Value))
+        FastCpuComboGroup(0x60, (Value = FastCpuRor(Cpu, Value), FastCpuAdc(Cpu, Value), Value))
+        FastCpuComboGroup(0xC0, (Value = Value - 1, FastCpuCompare(Cpu, Cpu->A, Value), Value))
+        FastCpuComboGroup(0xE0, (Value = Value + 1, FastCpuAdc(Cpu, Value ^ 0xFF), Value))
+
+        #undef FastCpuComboGroup
+
+        case 0x0B: case 0x2B: {
+            Cpu->A &= FastCpuRead(&Fast, Cpu->PC++);
+            FastCpuSetNZ(Cpu, Cpu->A);
+            FastCpuSetFlag(Cpu, M6502_CF, Cpu->A & 0x80);
+        } break;
+        case 0x4B: {
+            Cpu->A &= FastCpuRead(&Fast, Cpu->PC++);
+            Cpu->A = FastCpuLsr(Cpu, Cpu->A);
+        } break;
+        case 0x6B: {
+            Cpu->A &= FastCpuRead(&Fast, Cpu->PC++);
+            Cpu->A = (Cpu->A >> 1) | ((Cpu->P & M6502_CF) << 7);
+            FastCpuSetNZ(Cpu, Cpu->A);
+            FastCpuSetFlag(Cpu, M6502_CF, Cpu->A & 0x40);
+            FastCpuSetFlag(Cpu, M6502_VF, ((Cpu->A >> 6) ^ (Cpu->A >> 5)) & 0x01);
+        } break;
+        case 0xCB: {
+            u8 Operand = FastCpuRead(&Fast, Cpu->PC++);
+            u8 AndResult = Cpu->A & Cpu->X;
+            FastCpuSetFlag(Cpu, M6502_CF, AndResult >= Operand);
+            Cpu->X = AndResult - Operand;
+            FastCpuSetNZ(Cpu, Cpu->X);
+        } break;
+        case 0x8B: {
+            Cpu->A = (Cpu->A | FastCpuUnstableMagic) & Cpu->X & FastCpuRead(&Fast, Cpu->PC++);
+            FastCpuSetNZ(Cpu, Cpu->A);
+        } break;
+        case 0xAB: {
+            Cpu->A = (Cpu->A | FastCpuUnstableMagic) & FastCpuRead(&Fast, Cpu->PC++);
+            Cpu->X = Cpu->A;
+            FastCpuSetNZ(Cpu, Cpu->A);
+        } break;
+        case 0xBB: {
+            u8 Value = FastCpuRead(&Fast, FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 0)) & Cpu->S;
+            Cpu->A = Cpu->X = Cpu->S = Value;
+            FastCpuSetNZ(Cpu, Value);
+        } break;
+        case 0x93: {
+            u16 Address = FastCpuAddrIndirectY(&Fast, 1);
+            FastCpuWrite(&Fast, Address, Cpu->A & Cpu->X & FastCpuHighPlusOne(Address));
+        } break;
+        case 0x9F: {
+            u16 Address = FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 1);
+            FastCpuWrite(&Fast, Address, Cpu->A & Cpu->X & FastCpuHighPlusOne(Address));
+        } break;
+        case 0x9B: {
+            u16 Address = FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 1);
+            Cpu->S = Cpu->A & Cpu->X;
+            FastCpuWrite(&Fast, Address, Cpu->S & FastCpuHighPlusOne(Address));
+        } break;
+        case 0x9E: {
+            u16 Address = FastCpuAddrAbsoluteIndexed(&Fast, Cpu->Y, 1);
+            FastCpuWrite(&Fast, Address, Cpu->X & FastCpuHighPlusOne(Address));
+        } break;
+        case 0x9C: {
+            u16 Address = FastCpuAddrAbsoluteIndexed(&Fast, Cpu->X, 1);
+            FastCpuWrite(&Fast, Address, Cpu->Y & FastCpuHighPlusOne(Address));
+        } break;
+
+        // NOTE: JAM, the CPU locks up until reset
+        default: {
+            Cpu->PC--;
+            FastCpuIdle(&Fast);
+        } break;
+    }
+
+    // NOTE: RTI isn't here, it sets I before its poll
+    if (OpCode == 0x58 || OpCode == 0x78 || OpCode == 0x28) {
+        Bus->Scheduler.FastCpuIrqFlagClock = Fast.Clock;
+        Bus->Scheduler.FastCpuIrqFlag = IrqFlagBefore;
+    }
+
+    Bus->Scheduler.MasterClock = Fast.Clock;
+}
+
+#endif
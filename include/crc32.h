@@ -0,0 +1,210 @@
+#ifndef _EMU_CRC32_H
+#define _EMU_CRC32_H
+
+#include "base.h"
+#include "pixel_kernels.h"
+
+#include <string.h>
+
+/*
+
+    CRC-32 (IEEE, reflected 0xEDB88320, the one zip and the ROM databases
+    use) with variants picked by Crc32Init like the pixel kernels.
+
+    scalar: slicing-by-8, eight table lookups per 8 bytes.
+    pclmul: folds 64 bytes per step with carry-less multiplies, then a
+            Barrett reduction. Constants are the usual ones for this
+            polynomial (Intel, "Fast CRC Computation Using PCLMULQDQ").
+    armv8:  CRC32 instructions, picked at compile time.
+
+    SSE4.2 CRC32 computes CRC-32C, a different polynomial, so it can't be
+    used here. Kernels take and return the running state (inverted CRC),
+    Crc32 wraps them.
+
+*/
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32_ARM 1
+#else
+#define CRC32_ARM 0
+#endif
+
+#define Crc32Polynomial (0xEDB88320)
+
+typedef u32 crc32_kernel(u32 State, u8* Data, size_t Size);
+
+typedef struct crc32_variant {
+    char* Name;
+    crc32_kernel* Kernel;
+    u32 Features;
+} crc32_variant;
+
+global_variable u32 Crc32Table[8][256];
+global_variable bool32 Crc32TableReady;
+
+internal void
+Crc32BuildTable(void) {
+    for (u32 Byte = 0; Byte < 256; Byte++) {
+        u32 Crc = Byte;
+        for (i32 Bit = 0; Bit < 8; Bit++) {
+            Crc = (Crc & 1) ? ((Crc >> 1) ^ Crc32Polynomial) : (Crc >> 1);
+        }
+        Crc32Table[0][Byte] = Crc;
+    }
+    for (u32 Byte = 0; Byte < 256; Byte++) {
+        for (i32 Slice = 1; Slice < 8; Slice++) {
+            u32 Previous = Crc32Table[Slice - 1][Byte];
+            Crc32Table[Slice][Byte] = (Previous >> 8) ^ Crc32Table[0][Previous & 0xFF];
+        }
+    }
+    Crc32TableReady = 1;
+}
+
+internal u32
+Crc32UpdateScalar(u32 State, u8* Data, size_t Size) {
+    if (!Crc32TableReady) {
+        Crc32BuildTable();
+    }
+
+    // NOTE: Little endian host, like the rest of the emulator
+    while (Size >= 8) {
+        u32 Low;
+        u32 High;
+        memcpy(&Low, Data, sizeof(Low));
+        memcpy(&High, Data + 4, sizeof(High));
+        Low ^= State;
+        State = Crc32Table[7][Low & 0xFF] ^
+                Crc32Table[6][(Low >> 8) & 0xFF] ^
+                Crc32Table[5][(Low >> 16) & 0xFF] ^
+                Crc32Table[4][Low >> 24] ^
+                Crc32Table[3][High & 0xFF] ^
+                Crc32Table[2][(High >> 8) & 0xFF] ^
+                Crc32Table[1][(High >> 16) & 0xFF] ^
+                Crc32Table[0][High >> 24];
+        Data += 8;
+        Size -= 8;
+    }
+    while (Size--) {
+        State = (State >> 8) ^ Crc32Table[0][(State ^ *Data++) & 0xFF];
+    }
+    return State;
+}
+
+#if PIXEL_KERNELS_X86
+
+internal __m128i KernelTarget("pclmul,sse2")
+Crc32Fold(__m128i Accumulator, __m128i Data, __m128i Constants) {
+    __m128i Low = _mm_clmulepi64_si128(Accumulator, Constants, 0x00);
+    __m128i High = _mm_clmulepi64_si128(Accumulator, Constants, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(High, Low), Data);
+}
+
+internal u32 KernelTarget("pclmul,sse2")
+Crc32UpdatePclmul(u32 State, u8* Data, size_t Size) {
+    if (Size < 64) {
+        return Crc32UpdateScalar(State, Data, Size);
+    }
+
+    __m128i Fold4 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+    __m128i Fold1 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+    __m128i Reduce64 = _mm_set_epi64x(0, 0x0163CD6124);
+    __m128i Barrett = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+    __m128i Mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i X0 = _mm_loadu_si128((__m128i*)(Data + 0x00));
+    __m128i X1 = _mm_loadu_si128((__m128i*)(Data + 0x10));
+    __m128i X2 = _mm_loadu_si128((__m128i*)(Data + 0x20));
+    __m128i X3 = _mm_loadu_si128((__m128i*)(Data + 0x30));
+    X0 = _mm_xor_si128(X0, _mm_cvtsi32_si128((int)State));
+    Data += 64;
+    Size -= 64;
+
+    // NOTE: Four independent lanes hide the multiply latency
+    while (Size >= 64) {
+        X0 = Crc32Fold(X0, _mm_loadu_si128((__m128i*)(Data + 0x00)), Fold4);
+        X1 = Crc32Fold(X1, _mm_loadu_si128((__m128i*)(Data + 0x10)), Fold4);
+        X2 = Crc32Fold(X2, _mm_loadu_si128((__m128i*)(Data + 0x20)), Fold4);
+        X3 = Crc32Fold(X3, _mm_loadu_si128((__m128i*)(Data + 0x30)), Fold4);
+        Data += 64;
+        Size -= 64;
+    }
+
+    X0 = Crc32Fold(X0, X1, Fold1);
+    X0 = Crc32Fold(X0, X2, Fold1);
+    X0 = Crc32Fold(X0, X3, Fold1);
+    while (Size >= 16) {
+        X0 = Crc32Fold(X0, _mm_loadu_si128((__m128i*)Data), Fold1);
+        Data += 16;
+        Size -= 16;
+    }
+
+    // NOTE: 128 to 64 bits, then Barrett reduction to 32
+    __m128i Temp = _mm_clmulepi64_si128(X0, Fold1, 0x10);
+    X0 = _mm_xor_si128(_mm_srli_si128(X0, 8), Temp);
+    Temp = _mm_srli_si128(X0, 4);
+    X0 = _mm_and_si128(X0, Mask32);
+    X0 = _mm_clmulepi64_si128(X0, Reduce64, 0x00);
+    X0 = _mm_xor_si128(X0, Temp);
+
+    Temp = _mm_and_si128(X0, Mask32);
+    Temp = _mm_clmulepi64_si128(Temp, Barrett, 0x10);
+    Temp = _mm_and_si128(Temp, Mask32);
+    Temp = _mm_clmulepi64_si128(Temp, Barrett, 0x00);
+    X0 = _mm_xor_si128(X0, Temp);
+    State = (u32)_mm_cvtsi128_si32(_mm_srli_si128(X0, 4));
+
+    return Crc32UpdateScalar(State, Data, Size);
+}
+
+#endif
+
+#if CRC32_ARM
+
+internal u32
+Crc32UpdateArm(u32 State, u8* Data, size_t Size) {
+    while (Size >= 8) {
+        u64 Word;
+        memcpy(&Word, Data, sizeof(Word));
+        State = __crc32d(State, Word);
+        Data += 8;
+        Size -= 8;
+    }
+    while (Size--) {
+        State = __crc32b(State, *Data++);
+    }
+    return State;
+}
+
+#endif
+
+global_variable crc32_variant Crc32Variants[] = {
+    {"scalar", Crc32UpdateScalar, 0},
+#if PIXEL_KERNELS_X86
+    {"pclmul", Crc32UpdatePclmul, CpuSse2 | CpuPclmul},
+#endif
+#if CRC32_ARM
+    {"armv8", Crc32UpdateArm, 0},
+#endif
+};
+
+global_variable crc32_kernel* Crc32Update = Crc32UpdateScalar;
+global_variable char* Crc32UpdateName = "scalar";
+
+internal void
+Crc32Init(void) {
+    if (!Crc32TableReady) {
+        Crc32BuildTable();
+    }
+
+    crc32_variant* Variant = SelectKernelVariant(Crc32Variants);
+    Crc32Update = Variant->Kernel;
+    Crc32UpdateName = Variant->Name;
+}
+
+internal u32
+Crc32(u8* Data, size_t Size) {
+    return ~Crc32Update(0xFFFFFFFF, Data, Size);
+}
+
+#endif
@@ -0,0 +1,472 @@
+#ifndef _EMU_DEBUG_VIEW_H
+#define _EMU_DEBUG_VIEW_H
+
+#include "base.h"
+#include "emu_types.h"
+#include "bus.h"
+#include "ppu.h"
+#include "gfx.h"
+#include "system_font.h"
+#include "disassembly.h"
+#include "profiler.h"
+#include "arena.h"
+
+#include "m6502.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define DebugViewWidth (1280)
+#define DebugViewHeight (720)
+
+// NOTE: The debug screen is split into panels that don't overlap. Every
+//       panel refreshes at its own rate, in host time, and only panels that
+//       refreshed are drawn into the screen again, the rest of it keeps what
+//       was there. Drawing costs the same whether emulation runs at 60 or
+//       3000 frames per second.
+typedef enum debug_panel_id {
+    DebugPanel_Cpu,
+    DebugPanel_Ppu,
+    DebugPanel_Code,
+    DebugPanel_Memory,
+    DebugPanel_NesScreen,
+    DebugPanel_NameTables,
+    DebugPanel_PatternTables,
+    DebugPanel_Count,
+} debug_panel_id;
+
+typedef struct debug_panel {
+    // NOTE: Rectangle on the debug screen, in pixels
+    i32 X;
+    i32 Y;
+    i32 Width;
+    i32 Height;
+    // NOTE: Nanoseconds between refreshes, 0 refreshes on every draw
+    u64 Interval;
+    u64 LastRefresh;
+    bool32 Dirty;
+    u64 RefreshCount;
+} debug_panel;
+
+internal void
+DebugPanelInit(debug_panel* Panel, i32 X, i32 Y, i32 Width, i32 Height, u32 RefreshRate) {
+    memset(Panel, 0, sizeof(*Panel));
+    Panel->X = X;
+    Panel->Y = Y;
+    Panel->Width = Width;
+    Panel->Height = Height;
+    Panel->Interval = RefreshRate ? 1000000000ULL / RefreshRate : 0;
+    Panel->Dirty = 1;
+}
+
+// NOTE: True when the panel has to be drawn now, either because it was
+//       marked dirty or because its interval is up. An eighth of the interval
+//       is allowed early, so a 30Hz panel on a 60Hz host doesn't slip a frame
+//       every time vsync wakes up a little early.
+internal bool32
+DebugPanelRefresh(debug_panel* Panel, u64 Now) {
+    bool32 Due = (Now - Panel->LastRefresh) + (Panel->Interval / 8) >= Panel->Interval;
+    if (!Panel->Dirty && !Due) {
+        return 0;
+    }
+    Panel->Dirty = 0;
+    Panel->LastRefresh = Now;
+    Panel->RefreshCount++;
+    return 1;
+}
+
+internal void
+DebugPanelClear(pixel_buffer* Screen, debug_panel* Panel) {
+    PixelBufferFillRect(Screen, Panel->X, Panel->Y, Panel->Width, Panel->Height, 0xFF000000);
+}
+
+// NOTE: One line of text, cut at the panel's right edge so it can't spill
+//       into the panel next to it
+internal void
+DebugPanelPrint(pixel_buffer* Screen, debug_panel* Panel, i32 Row, u8* Text) {
+    i32 CellCount = Panel->Width / EmbeddedFontWidth;
+    if ((i32)strlen((char*)Text) > CellCount) {
+        Text[CellCount] = 0;
+    }
+    PrintToPixelBuffer(Screen, Panel->X / EmbeddedFontWidth, (Panel->Y / EmbeddedFontHeight) + Row, Text);
+}
+
+internal void
+DrawCpuState(pixel_buffer* Screen,
+             debug_panel* Panel,
+             m6502_t* Cpu,
+             bus* Bus,
+             f32 FrameDelta,
+             memory_arena* Scratch) {
+    u8* Text = ArenaPrintf(Scratch, "Tick:%010llu Frame:%7.3fms",
+        (unsigned long long)Bus->Scheduler.MasterClock, FrameDelta * 1000.0f);
+    DebugPanelPrint(Screen, Panel, 0, Text);
+    Text = ArenaPrintf(Scratch, "PC:%04X A:%02X X:%02X Y:%02X S:%02X P:%02X",
+        Cpu->PC, Cpu->A, Cpu->X, Cpu->Y, Cpu->S, Cpu->P);
+    DebugPanelPrint(Screen, Panel, 1, Text);
+}
+
+internal void
+DrawPpuState(pixel_buffer* Screen,
+             debug_panel* Panel,
+             ppu* Ppu,
+             memory_arena* Scratch) {
+    u8* Text = ArenaPrintf(Scratch, "S: %04d, D: %03d, CTRL: %02X, STATUS: %02X, OAMADDR: %04X (%04X)",
+        Ppu->Scanline, Ppu->Dot,
+        Ppu->Control,
+        PpuPackStatus(Ppu),
+        Ppu->Oam.Address,
+        Ppu->Oam.TempAddress);
+    DebugPanelPrint(Screen, Panel, 0, Text);
+}
+
+global_variable u32 PoorMansPallete[4] = {
+    0xFFCC0000,
+    0xFF33CC33,
+    0xFF7777CC,
+    0xFFEEEEEE,
+};
+
+#define PatternTableViewWidth  (2 * PatternsPerColum * PatternSizeInPixels)
+#define PatternTableViewHeight (PatternsPerColum * PatternSizeInPixels)
+#define NameTableViewWidth     (2 * NametableTileTilePerRowCount * NametableTileSize)
+#define NameTableViewHeight    (2 * NametableTileRowCount * NametableTileSize)
+
+// NOTE: Viewers keep their own buffers and only redraw tiles that changed
+//       since the last update. Pattern tables follow chr_cache versions,
+//       nametables compare against a copy of what they drew last time.
+typedef struct pattern_table_view {
+    pixel_buffer Buffer;
+    bool32 Valid;
+    u32 ChrGeneration;
+    u32 TileVersion[ChrTileCount];
+} pattern_table_view;
+
+typedef struct name_table_view {
+    pixel_buffer Buffer;
+    bool32 Valid;
+    u32 ChrGeneration;
+    u8 Control;
+    u8 Palette[16];
+    u8* LogicalTables[4];
+    u8 DrawnNameTable[2][1024];
+    u32 TileChrVersion[4][NametableTileRowCount * NametableTileTilePerRowCount];
+} name_table_view;
+
+#define MemoryViewColumnCount  (24)
+#define MemoryViewRowCount     (78)
+#define MemoryViewCellCount    (MemoryViewColumnCount * MemoryViewRowCount)
+#define MemoryViewAddressCells (5)
+#define MemoryViewWidth        ((MemoryViewAddressCells + (MemoryViewColumnCount * 2)) * EmbeddedFontWidth)
+#define MemoryViewHeight       (MemoryViewRowCount * EmbeddedFontHeight)
+#define MemoryViewFadeSteps    (32)
+#define MemoryViewForeground   (0xFFFFFFFF)
+#define MemoryViewBackground   (0xFF000000)
+#define MemoryViewHighlight    (0xFF00FFFF)
+
+// NOTE: Hex dump of MemoryViewCellCount bytes from Start. Bytes are peeked
+//       from the pages' backing memory (I/O reads as 0, nothing is
+//       triggered) and compared against the shadow of what was drawn, only
+//       cells that changed or are still fading are redrawn. Fading goes one
+//       step per update, so it follows the panel's refresh rate.
+typedef struct memory_view {
+    pixel_buffer Buffer;
+    bool32 Valid;
+    u16 Start;
+    u16 DrawnStart;
+    u8 Shadow[MemoryViewCellCount];
+    u8 Fade[MemoryViewCellCount];
+} memory_view;
+
+#define DebugPanelTextWidth (53 * EmbeddedFontWidth)
+
+typedef struct debug_views {
+    pattern_table_view PatternTables;
+    name_table_view NameTables;
+    memory_view Memory;
+    debug_panel Panels[DebugPanel_Count];
+    // NOTE: Cleared once, afterwards only panel rectangles are drawn
+    bool32 ScreenValid;
+} debug_views;
+
+// NOTE: Every panel is drawn on the next DrawDebugView, for when the screen
+//       was used for something else or all panels have to be current
+internal void
+DebugViewsInvalidate(debug_views* Views) {
+    for (i32 PanelIndex = 0; PanelIndex < DebugPanel_Count; PanelIndex++) {
+        Views->Panels[PanelIndex].Dirty = 1;
+    }
+}
+
+internal void
+DebugViewsInit(debug_views* Views, memory_arena* Arena) {
+    memset(Views, 0, sizeof(*Views));
+    Views->PatternTables.Buffer.Width = PatternTableViewWidth;
+    Views->PatternTables.Buffer.Height = PatternTableViewHeight;
+    Views->PatternTables.Buffer.Memory = ArenaPushArray(Arena, u32, PatternTableViewWidth * PatternTableViewHeight);
+    Views->NameTables.Buffer.Width = NameTableViewWidth;
+    Views->NameTables.Buffer.Height = NameTableViewHeight;
+    Views->NameTables.Buffer.Memory = ArenaPushArray(Arena, u32, NameTableViewWidth * NameTableViewHeight);
+    Views->Memory.Buffer.Width = MemoryViewWidth;
+    Views->Memory.Buffer.Height = MemoryViewHeight;
+    Views->Memory.Buffer.Memory = ArenaPushArray(Arena, u32, MemoryViewWidth * MemoryViewHeight);
+
+    DebugPanelInit(Views->Panels + DebugPanel_Cpu, 8 * 1, 8 * 1, DebugPanelTextWidth, 8 * 2, 30);
+    DebugPanelInit(Views->Panels + DebugPanel_Ppu, 8 * 1, 8 * 3, DebugPanelTextWidth, 8 * 1, 30);
+    DebugPanelInit(Views->Panels + DebugPanel_Code, 8 * 1, 8 * 4, DebugPanelTextWidth,
+                   8 * ((AroundInstructionCount * 2) + 1), 30);
+    DebugPanelInit(Views->Panels + DebugPanel_Memory, 8 * 1, 8 * 12, MemoryViewWidth, MemoryViewHeight, 30);
+    DebugPanelInit(Views->Panels + DebugPanel_NesScreen, 8 * 54, 8 * 1, NesScreenWidth, NesScreenHeight, 60);
+    DebugPanelInit(Views->Panels + DebugPanel_NameTables, 8 * 90, 8 * 1, NameTableViewWidth, NameTableViewHeight, 30);
+    DebugPanelInit(Views->Panels + DebugPanel_PatternTables, 8 * 54, 8 * 40,
+                   PatternTableViewWidth, PatternTableViewHeight, 15);
+}
+
+// NOTE: Rows, positive goes to higher addresses. Wraps around $FFFF.
+internal void
+MemoryViewScroll(memory_view* View, i32 Rows) {
+    View->Start = (u16)(View->Start + (Rows * MemoryViewColumnCount));
+}
+
+global_variable u8 HexDigits[16] = {
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+};
+
+// NOTE: Highlight blended towards the foreground as Fade runs out. Blending
+//       four steps at a time keeps the number of glyph atlas colour pairs small.
+internal u32
+MemoryViewCellColor(u8 Fade) {
+    Fade = (u8)((Fade + 3) & ~3);
+    u32 Result = 0xFF000000;
+    for (i32 Shift = 0; Shift < 24; Shift += 8) {
+        i32 From = (MemoryViewForeground >> Shift) & 0xFF;
+        i32 To = (MemoryViewHighlight >> Shift) & 0xFF;
+        i32 Channel = From + (((To - From) * Fade) / MemoryViewFadeSteps);
+        Result |= (u32)Channel << Shift;
+    }
+    return Result;
+}
+
+internal void
+UpdateMemoryView(memory_view* View, bus* Bus) {
+    BeginTimedBlock(DrawRam);
+    bool32 Redraw = !View->Valid || View->DrawnStart != View->Start;
+    if (Redraw) {
+        PixelBufferClear(&View->Buffer, MemoryViewBackground);
+        memset(View->Fade, 0, sizeof(View->Fade));
+        for (i32 Row = 0; Row < MemoryViewRowCount; Row++) {
+            u16 Address = (u16)(View->Start + (Row * MemoryViewColumnCount));
+            for (i32 Digit = 0; Digit < 4; Digit++) {
+                PutCharOpaque(&View->Buffer, Digit, Row, HexDigits[(Address >> (12 - (Digit * 4))) & 0xF],
+                              MemoryViewForeground, MemoryViewBackground);
+            }
+            PutCharOpaque(&View->Buffer, 4, Row, ':', MemoryViewForeground, MemoryViewBackground);
+        }
+    }
+
+    for (i32 Cell = 0; Cell < MemoryViewCellCount; Cell++) {
+        u8 Value = BusPeek(Bus, (u16)(View->Start + Cell));
+        bool32 Changed = (Value != View->Shadow[Cell]);
+        if (!Redraw && !Changed && !View->Fade[Cell]) {
+            continue;
+        }
+
+        if (Changed && !Redraw) {
+            View->Fade[Cell] = MemoryViewFadeSteps;
+        } else if (View->Fade[Cell]) {
+            View->Fade[Cell]--;
+        }
+        View->Shadow[Cell] = Value;
+
+        i32 CellX = MemoryViewAddressCells + ((Cell % MemoryViewColumnCount) * 2);
+        i32 CellY = Cell / MemoryViewColumnCount;
+        u32 Color = MemoryViewCellColor(View->Fade[Cell]);
+        PutCharOpaque(&View->Buffer, CellX, CellY, HexDigits[Value >> 4], Color, MemoryViewBackground);
+        PutCharOpaque(&View->Buffer, CellX + 1, CellY, HexDigits[Value & 0xF], Color, MemoryViewBackground);
+    }
+
+    View->Valid = 1;
+    View->DrawnStart = View->Start;
+    EndTimedBlock(DrawRam);
+}
+
+internal void
+DrawTile(pixel_buffer* Dest, i32 X, i32 Y, u8* TilePixel, u32* Colors) {
+    u32* DestRow = Dest->Memory + (Y * Dest->Width) + X;
+    for (i32 PixelOffsetY = 0; PixelOffsetY < PatternSizeInPixels; PixelOffsetY++) {
+        for (i32 PixelOffsetX = 0; PixelOffsetX < PatternSizeInPixels; PixelOffsetX++) {
+            DestRow[PixelOffsetX] = Colors[*TilePixel++];
+        }
+        DestRow += Dest->Width;
+    }
+}
+
+internal void
+UpdatePatternTableView(pattern_table_view* View, bus* Bus) {
+    BeginTimedBlock(PatternTables);
+    chr_cache* Cache = Bus->ChrCache;
+    if (!View->Valid || View->ChrGeneration != Cache->Generation) {
+        for (i32 TileIndex = 0; TileIndex < ChrTileCount; TileIndex++) {
+            if (View->Valid && View->TileVersion[TileIndex] == Cache->Version[TileIndex]) {
+                continue;
+            }
+            //TODO: Better name for PatternsPerColum
+            i32 Half = TileIndex / 256;
+            i32 Row = (TileIndex % 256) / PatternsPerColum;
+            i32 Column = TileIndex % PatternsPerColum;
+            DrawTile(&View->Buffer,
+                     (Half * PatternsPerColum * PatternSizeInPixels) + (Column * PatternSizeInPixels),
+                     Row * PatternSizeInPixels,
+                     ChrCacheTile(Bus, TileIndex),
+                     PoorMansPallete);
+            View->TileVersion[TileIndex] = Cache->Version[TileIndex];
+        }
+        View->ChrGeneration = Cache->Generation;
+        View->Valid = 1;
+    }
+    EndTimedBlock(PatternTables);
+}
+
+internal void
+UpdateNameTableView(name_table_view* View, bus* Bus) {
+    BeginTimedBlock(NameTables);
+    ppu* Ppu = Bus->Ppu;
+    chr_cache* Cache = Bus->ChrCache;
+
+    u8* LogicalTables[4];
+    for (i32 Table = 0; Table < 4; Table++) {
+        LogicalTables[Table] = PpuNameTable(Bus, 0x2000 | (Table << 10));
+    }
+
+    u8 Control = Ppu->Control & BackgroundTileSelectMask;
+    bool32 RedrawAll = !View->Valid ||
+                       View->Control != Control ||
+                       memcmp(View->Palette, Ppu->Palette, sizeof(View->Palette)) != 0 ||
+                       memcmp(View->LogicalTables, LogicalTables, sizeof(LogicalTables)) != 0;
+    bool32 ChrChanged = View->ChrGeneration != Cache->Generation;
+    i32 TileBase = Control ? 256 : 0;
+
+    for (i32 Table = 0; Table < 4; Table++) {
+        u8* NameTable = LogicalTables[Table];
+        u8* DrawnNameTable = View->DrawnNameTable[(NameTable == Ppu->NameTable[0]) ? 0 : 1];
+        i32 TableX = (Table & 1) * NametableTileTilePerRowCount * NametableTileSize;
+        i32 TableY = (Table >> 1) * NametableTileRowCount * NametableTileSize;
+
+        // NOTE: Nothing to do for a table that didn't change, unless CHR did
+        if (!RedrawAll && !ChrChanged && memcmp(NameTable, DrawnNameTable, 1024) == 0) {
+            continue;
+        }
+
+        for (i32 Row = 0; Row < NametableTileRowCount; Row++) {
+            for (i32 Column = 0; Column < NametableTileTilePerRowCount; Column++) {
+                i32 EntryIndex = (Row * NametableTileTilePerRowCount) + Column;
+                i32 AttributeIndex = 0x03C0 + ((Row >> 2) * 8) + (Column >> 2);
+                i32 TileIndex = TileBase + NameTable[EntryIndex];
+
+                bool32 Changed = RedrawAll ||
+                                 NameTable[EntryIndex] != DrawnNameTable[EntryIndex] ||
+                                 NameTable[AttributeIndex] != DrawnNameTable[AttributeIndex] ||
+                                 View->TileChrVersion[Table][EntryIndex] != Cache->Version[TileIndex];
+                if (!Changed) {
+                    continue;
+                }
+
+                u8 PaletteSelect = (NameTable[AttributeIndex] >> (((Row & 0b10) << 1) | (Column & 0b10))) & 0b11;
+                u8* Palette = Ppu->Palette + (PaletteSelect * 4);
+                u32 Colors[4] = {
+                    NesColors[Ppu->Palette[0]],
+                    NesColors[Palette[1]],
+                    NesColors[Palette[2]],
+                    NesColors[Palette[3]],
+                };
+
+                DrawTile(&View->Buffer,
+                         TableX + (Column * NametableTileSize),
+                         TableY + (Row * NametableTileSize),
+                         ChrCacheTile(Bus, TileIndex),
+                         Colors);
+                View->TileChrVersion[Table][EntryIndex] = Cache->Version[TileIndex];
+            }
+        }
+    }
+
+    // NOTE: Only after all 4 logical tables, mirrored ones share a copy
+    memcpy(View->DrawnNameTable, Ppu->NameTable, sizeof(View->DrawnNameTable));
+    memcpy(View->Palette, Ppu->Palette, sizeof(View->Palette));
+    memcpy(View->LogicalTables, LogicalTables, sizeof(LogicalTables));
+    View->Control = Control;
+    View->ChrGeneration = Cache->Generation;
+    View->Valid = 1;
+    EndTimedBlock(NameTables);
+}
+
+// NOTE: Now is PlatformTimeNanoseconds, panels refresh against it. Returns
+//       the number of panels drawn, 0 means Screen is unchanged.
+internal i32
+DrawDebugView(pixel_buffer* Screen,
+              pixel_buffer* NesScreen,
+              debug_views* Views,
+              m6502_t* Cpu,
+              bus* Bus,
+              disassembler* Disassembler,
+              f32 FrameDelta,
+              u64 Now,
+              memory_arena* Scratch) {
+    ppu* Ppu = Bus->Ppu;
+    debug_panel* Panels = Views->Panels;
+    i32 DrawnCount = 0;
+
+    if (!Views->ScreenValid) {
+        PixelBufferClear(Screen, 0xFF000000);
+        DebugViewsInvalidate(Views);
+        Views->ScreenValid = 1;
+    }
+    // NOTE: Scrolling shows up right away instead of on the next refresh
+    if (Views->Memory.Start != Views->Memory.DrawnStart) {
+        Panels[DebugPanel_Memory].Dirty = 1;
+    }
+
+    if (DebugPanelRefresh(Panels + DebugPanel_Cpu, Now)) {
+        DebugPanelClear(Screen, Panels + DebugPanel_Cpu);
+        DrawCpuState(Screen, Panels + DebugPanel_Cpu, Cpu, Bus, FrameDelta, Scratch);
+        DrawnCount++;
+    }
+    if (DebugPanelRefresh(Panels + DebugPanel_Ppu, Now)) {
+        DebugPanelClear(Screen, Panels + DebugPanel_Ppu);
+        DrawPpuState(Screen, Panels + DebugPanel_Ppu, Ppu, Scratch);
+        DrawnCount++;
+    }
+    if (DebugPanelRefresh(Panels + DebugPanel_Code, Now)) {
+        BeginTimedBlock(DrawCode);
+        debug_panel* Panel = Panels + DebugPanel_Code;
+        DebugPanelClear(Screen, Panel);
+        DrawCode(Screen, Panel->X / EmbeddedFontWidth, Panel->Y / EmbeddedFontHeight, Cpu->PC, Bus, Disassembler);
+        EndTimedBlock(DrawCode);
+        DrawnCount++;
+    }
+    if (DebugPanelRefresh(Panels + DebugPanel_Memory, Now)) {
+        UpdateMemoryView(&Views->Memory, Bus);
+        PixelBufferBlit(Screen, &Views->Memory.Buffer, Panels[DebugPanel_Memory].X, Panels[DebugPanel_Memory].Y);
+        DrawnCount++;
+    }
+    if (DebugPanelRefresh(Panels + DebugPanel_NesScreen, Now)) {
+        PixelBufferBlit(Screen, NesScreen, Panels[DebugPanel_NesScreen].X, Panels[DebugPanel_NesScreen].Y);
+        DrawnCount++;
+    }
+    if (DebugPanelRefresh(Panels + DebugPanel_NameTables, Now)) {
+        UpdateNameTableView(&Views->NameTables, Bus);
+        PixelBufferBlit(Screen, &Views->NameTables.Buffer,
+                        Panels[DebugPanel_NameTables].X, Panels[DebugPanel_NameTables].Y);
+        DrawnCount++;
+    }
+    if (DebugPanelRefresh(Panels + DebugPanel_PatternTables, Now)) {
+        UpdatePatternTableView(&Views->PatternTables, Bus);
+        PixelBufferBlit(Screen, &Views->PatternTables.Buffer,
+                        Panels[DebugPanel_PatternTables].X, Panels[DebugPanel_PatternTables].Y);
+        DrawnCount++;
+    }
+
+    return DrawnCount;
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include "base.h"
 #include "gfx.h"
 #include "system_font.h"
+#include "emu_types.h"
+#include "bus.h"
 
 #include <string.h>
 
@@ -133,7 +135,7 @@ InitInstructionsDictionary(instruction_info* Instructions) {
     Instructions[0x00].Mnemonic = BRK;
     Instructions[0x00].AddressingMode = Implicit;
     Instructions[0x20].Mnemonic = JSR;
-    Instructions[0x20].AddressingMode = Implicit;
+    Instructions[0x20].AddressingMode = Absolute;
     Instructions[0x40].Mnemonic = RTI;
     Instructions[0x40].AddressingMode = Implicit;
     Instructions[0x60].Mnemonic = RTS;
@@ -845,7 +847,7 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString);
         } break;
         case Immediate: {
-            u8 ArgumentValue = BusRead(Bus, Address + 1);
+            u8 ArgumentValue = BusPeek(Bus, Address + 1);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X)     %s #$%02X\0",
@@ -854,7 +856,7 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, ArgumentValue);
         } break;
         case ZeroPage: {
-            u8 ArgumentValue = BusRead(Bus, Address + 1);
+            u8 ArgumentValue = BusPeek(Bus, Address + 1);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X)     %s $%02X\0",
@@ -863,7 +865,7 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, ArgumentValue);
         } break;
         case ZeroPageX: {
-            u8 ArgumentValue = BusRead(Bus, Address + 1);
+            u8 ArgumentValue = BusPeek(Bus, Address + 1);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X)     %s $%02X,X\0",
@@ -872,7 +874,7 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, ArgumentValue);
         } break;
         case ZeroPageY: {
-            u8 ArgumentValue = BusRead(Bus, Address + 1);
+            u8 ArgumentValue = BusPeek(Bus, Address + 1);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X)     %s $%02X,Y\0",
@@ -881,7 +883,7 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, ArgumentValue);
         } break;
         case Relative: {
-            u8 ArgumentValue = BusRead(Bus, Address + 1);
+            u8 ArgumentValue = BusPeek(Bus, Address + 1);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X)     %s *%d\0",
@@ -890,8 +892,8 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, (i8)ArgumentValue);
         } break;
         case Absolute: {
-            u8 ArgumentValue1 = BusRead(Bus, Address + 1);
-            u8 ArgumentValue2 = BusRead(Bus, Address + 2);
+            u8 ArgumentValue1 = BusPeek(Bus, Address + 1);
+            u8 ArgumentValue2 = BusPeek(Bus, Address + 2);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X, %02X) %s $%02X%02X\0",
@@ -900,8 +902,8 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, ArgumentValue2, ArgumentValue1);
         } break;
         case AbsoluteX: {
-            u8 ArgumentValue1 = BusRead(Bus, Address + 1);
-            u8 ArgumentValue2 = BusRead(Bus, Address + 2);
+            u8 ArgumentValue1 = BusPeek(Bus, Address + 1);
+            u8 ArgumentValue2 = BusPeek(Bus, Address + 2);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X, %02X) %s $%02X%02X,X\0",
@@ -910,8 +912,8 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, ArgumentValue2, ArgumentValue1);
         } break;
         case AbsoluteY: {
-            u8 ArgumentValue1 = BusRead(Bus, Address + 1);
-            u8 ArgumentValue2 = BusRead(Bus, Address + 2);
+            u8 ArgumentValue1 = BusPeek(Bus, Address + 1);
+            u8 ArgumentValue2 = BusPeek(Bus, Address + 2);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X, %02X) %s $%02X%02X,Y\0",
@@ -920,8 +922,8 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, ArgumentValue2, ArgumentValue1);
         } break;
         case Indirect: {
-            u8 ArgumentValue1 = BusRead(Bus, Address + 1);
-            u8 ArgumentValue2 = BusRead(Bus, Address + 2);
+            u8 ArgumentValue1 = BusPeek(Bus, Address + 1);
+            u8 ArgumentValue2 = BusPeek(Bus, Address + 2);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X, %02X) %s $(%02X%02X)\0",
@@ -930,7 +932,7 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, ArgumentValue2, ArgumentValue1);
         } break;
         case IndirectX: {
-            u8 ArgumentValue = BusRead(Bus, Address + 1);
+            u8 ArgumentValue = BusPeek(Bus, Address + 1);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X)     %s ($%02X,X)\0",
@@ -939,7 +941,7 @@ FormatDisassembledInstruction(u16 Address,
                 MnemonicString, ArgumentValue);
         } break;
         case IndirectY: {
-            u8 ArgumentValue = BusRead(Bus, Address + 1);
+            u8 ArgumentValue = BusPeek(Bus, Address + 1);
             sprintf(
                 CharBuffer,
                 "%04X: (%02X, %02X)     %s ($%02X),Y\0",
@@ -963,68 +965,263 @@ internal void PrintDisassembledInstruction(u16 Address,
     PlatformPrint(CharBuffer);
 }
 
-internal void
-Dissasemble(bus* Bus,
-            instruction_info* InstructionsDict,
-            u8** DisassemledInstructions,
-            u8* DissasemblyStringData) {
-    u32 Address = 0x0000;
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define DisassemblerPopCount64(Value) ((i32)__popcnt64(Value))
+#define DisassemblerLowestBit64(Value) ((i32)_tzcnt_u64(Value))
+#else
+#define DisassemblerPopCount64(Value) __builtin_popcountll(Value)
+#define DisassemblerLowestBit64(Value) __builtin_ctzll(Value)
+#endif
 
-    u8* StringData = DissasemblyStringData;
+#define DisassemblerPendingCount   (256)
+#define DisassemblyRowCacheCount   (64)
+#define DisassemblyRowTextSize     (40)
+#define InstructionStartWordCount  (0x10000 / 64)
 
-    do {
-        u8 InstructionOpCode = BusRead(Bus, Address);
+// NOTE: Formatted text of one row, valid while the bytes it was made from
+//       are still there. That covers code in RAM and switched PRG banks.
+typedef struct disassembly_row {
+    bool32 Valid;
+    bool32 Data;
+    u16 Address;
+    u8 Bytes[3];
+    u8 Text[DisassemblyRowTextSize];
+} disassembly_row;
 
-        FormatDisassembledInstruction((u16)Address,
-                                      InstructionOpCode,
-                                      Bus,
-                                      InstructionsDict,
-                                      StringData);
+// NOTE: What was decoded at an instruction start. Stale once the memory
+//       there holds another opcode (code in RAM).
+typedef struct decoded_instruction {
+    u8 OpCode;
+    u8 Length;
+} decoded_instruction;
 
-        DisassemledInstructions[Address] = StringData;
-        StringData += strlen(StringData);
-        StringData += 1;
+// NOTE: Instruction starts come from the code/data log (what the CPU really
+//       executed) and from tracing control flow out of the vectors and PC.
+//       Only read-only pages are traced, code in RAM is known from the log.
+//       Starts are a bitmap, StartRank[Word] counts the starts below Word and
+//       StartAddress[N] is the address of start N, both rebuilt lazily, so
+//       previous/next start is a rank and a select in constant time.
+typedef struct disassembler {
+    instruction_info* InstructionsDict;
+    u8* CodeDataLog;
+    u8* PageSource[BusPageCount];
+    decoded_instruction Decoded[0x10000];
+    u64 StartBits[InstructionStartWordCount];
+    u32 StartRank[InstructionStartWordCount + 1];
+    u16 StartAddress[0x10000];
+    bool32 RankStale;
+    u16 Pending[DisassemblerPendingCount];
+    i32 PendingCount;
+    disassembly_row Rows[DisassemblyRowCacheCount];
+} disassembler;
 
-        i32 InstructionSize = AddressingModeToSize(
-            InstructionsDict[InstructionOpCode].AddressingMode);
-        Address += InstructionSize;
-    } while (Address <= 0xFFFF);
+internal bool32
+DisassemblerIsTraceable(bus* Bus, u16 Address) {
+    bus_page* Page = Bus->Pages + (Address >> 8);
+    return Page->Read && !Page->Write;
 }
 
-internal u16
-FindValidAddress(u16 Address, u8** DisassemledInstructions) {
-    u16 ValidAddress = Address;
-    while (!DisassemledInstructions[ValidAddress]) {
-        ValidAddress--;
+internal bool32
+DisassemblerHasStart(disassembler* Disassembler, u16 Address) {
+    return (Disassembler->StartBits[Address >> 6] >> (Address & 63)) & 1;
+}
+
+internal bool32
+DisassemblerIsInstruction(disassembler* Disassembler, bus* Bus, u16 Address) {
+    return DisassemblerHasStart(Disassembler, Address) &&
+           Disassembler->Decoded[Address].OpCode == BusPeek(Bus, Address);
+}
+
+internal i32
+DisassemblerInstructionSize(disassembler* Disassembler, bus* Bus, u16 Address) {
+    u8 OpCode = BusPeek(Bus, Address);
+    return AddressingModeToSize(Disassembler->InstructionsDict[OpCode].AddressingMode);
+}
+
+internal void
+DisassemblerMarkStart(disassembler* Disassembler, bus* Bus, u16 Address) {
+    decoded_instruction* Decoded = Disassembler->Decoded + Address;
+    Decoded->OpCode = BusPeek(Bus, Address);
+    Decoded->Length = (u8)AddressingModeToSize(Disassembler->InstructionsDict[Decoded->OpCode].AddressingMode);
+    if (!DisassemblerHasStart(Disassembler, Address)) {
+        Disassembler->StartBits[Address >> 6] |= (u64)1 << (Address & 63);
+        Disassembler->RankStale = 1;
     }
-    return ValidAddress;
 }
 
-internal u16
-FindNextAddress(u16 Address, u8** DisassemledInstructions) {
-    u16 ValidAddress = Address + 1;
-    while (!DisassemledInstructions[ValidAddress]) {
-        ValidAddress++;
+internal void
+DisassemblerBuildRank(disassembler* Disassembler) {
+    u32 Count = 0;
+    for (i32 Word = 0; Word < InstructionStartWordCount; Word++) {
+        Disassembler->StartRank[Word] = Count;
+        u64 Bits = Disassembler->StartBits[Word];
+        while (Bits) {
+            Disassembler->StartAddress[Count++] = (u16)((Word * 64) + DisassemblerLowestBit64(Bits));
+            Bits &= Bits - 1;
+        }
     }
-    return ValidAddress;
+    Disassembler->StartRank[InstructionStartWordCount] = Count;
+    Disassembler->RankStale = 0;
+}
+
+// NOTE: Number of instruction starts below Address
+internal u32
+DisassemblerRank(disassembler* Disassembler, u16 Address) {
+    u64 BelowMask = ((u64)1 << (Address & 63)) - 1;
+    return Disassembler->StartRank[Address >> 6] +
+           DisassemblerPopCount64(Disassembler->StartBits[Address >> 6] & BelowMask);
 }
 
+// NOTE: Address of instruction start number Index, Index has to be below
+//       the total count
 internal u16
-FindPreviousAddress(u16 Address, u8** DisassemledInstructions) {
-    u16 ValidAddress = Address - 1;
-    while (!DisassemledInstructions[ValidAddress]) {
-        ValidAddress--;
+DisassemblerSelect(disassembler* Disassembler, u32 Index) {
+    return Disassembler->StartAddress[Index];
+}
+
+internal void
+DisassemblerPush(disassembler* Disassembler, u16 Address) {
+    // NOTE: Dropped targets are found later, from the log or from PC
+    if (Disassembler->PendingCount < DisassemblerPendingCount) {
+        Disassembler->Pending[Disassembler->PendingCount++] = Address;
+    }
+}
+
+internal void
+DisassemblerTrace(disassembler* Disassembler, bus* Bus, u16 StartAddress) {
+    DisassemblerPush(Disassembler, StartAddress);
+    while (Disassembler->PendingCount) {
+        u16 Address = Disassembler->Pending[--Disassembler->PendingCount];
+        for (;;) {
+            if (DisassemblerHasStart(Disassembler, Address) || !DisassemblerIsTraceable(Bus, Address)) {
+                break;
+            }
+
+            u8 OpCode = BusPeek(Bus, Address);
+            instruction_info* Info = Disassembler->InstructionsDict + OpCode;
+            if (Info->Mnemonic == HLT) {
+                break;
+            }
+            DisassemblerMarkStart(Disassembler, Bus, Address);
+
+            u16 Next = Address + AddressingModeToSize(Info->AddressingMode);
+            u16 Target = BusPeek(Bus, Address + 1) | (BusPeek(Bus, Address + 2) << 8);
+            if (Info->AddressingMode == Relative) {
+                DisassemblerPush(Disassembler, Next + (i8)BusPeek(Bus, Address + 1));
+            } else if (Info->Mnemonic == JSR) {
+                DisassemblerPush(Disassembler, Target);
+            } else if (Info->Mnemonic == JMP) {
+                if (Info->AddressingMode == Indirect) {
+                    break;
+                }
+                Next = Target;
+            } else if (Info->Mnemonic == RTS || Info->Mnemonic == RTI || Info->Mnemonic == BRK) {
+                break;
+            }
+            Address = Next;
+        }
+    }
+}
+
+internal void
+DisassemblerTraceVector(disassembler* Disassembler, bus* Bus, u16 Vector) {
+    DisassemblerTrace(Disassembler, Bus, BusPeek(Bus, Vector) | (BusPeek(Bus, Vector + 1) << 8));
+}
+
+// NOTE: Takes the opcodes the CPU executed around Address from the log, as
+//       far as they were executed from the banks mapped now
+internal void
+DisassemblerSyncLog(disassembler* Disassembler, bus* Bus, u16 Address) {
+    u16 Start = (Address & ~63) - 64;
+    for (i32 Offset = 0; Offset < (3 * 64); Offset++) {
+        u16 LogAddress = Start + Offset;
+        i32 LogOffset = CodeDataLogOffset(Bus, LogAddress);
+        if (LogOffset >= 0 && (Disassembler->CodeDataLog[LogOffset] & CodeDataLogCode) &&
+            !DisassemblerIsInstruction(Disassembler, Bus, LogAddress)) {
+            DisassemblerMarkStart(Disassembler, Bus, LogAddress);
+        }
+    }
+}
+
+// NOTE: Has to be called before the first DrawCode, Bus->CodeDataLog has to
+//       be set up already
+internal void
+DisassemblerInit(disassembler* Disassembler, bus* Bus, instruction_info* InstructionsDict) {
+    memset(Disassembler, 0, sizeof(*Disassembler));
+    Disassembler->InstructionsDict = InstructionsDict;
+    Disassembler->CodeDataLog = Bus->CodeDataLog;
+    for (i32 Page = 0; Page < BusPageCount; Page++) {
+        Disassembler->PageSource[Page] = Bus->Pages[Page].Read;
+    }
+    DisassemblerTraceVector(Disassembler, Bus, NmiVector);
+    DisassemblerTraceVector(Disassembler, Bus, ResetVector);
+    DisassemblerTraceVector(Disassembler, Bus, IrqVector);
+}
+
+// NOTE: Pages that now show different memory (bank switch) lose the starts
+//       found in them, the vectors are traced again in case they moved. The
+//       log is per bank, so DisassemblerSyncLog finds the new bank's code.
+internal void
+DisassemblerUpdate(disassembler* Disassembler, bus* Bus) {
+    bool32 Remapped = 0;
+    for (i32 Page = 0; Page < BusPageCount; Page++) {
+        if (Disassembler->PageSource[Page] != Bus->Pages[Page].Read) {
+            i32 FirstWord = (Page * BusPageSize) / 64;
+            memset(Disassembler->StartBits + FirstWord, 0, BusPageSize / 8);
+            Disassembler->PageSource[Page] = Bus->Pages[Page].Read;
+            Remapped = 1;
+        }
+    }
+    if (Remapped) {
+        Disassembler->RankStale = 1;
+        DisassemblerTraceVector(Disassembler, Bus, NmiVector);
+        DisassemblerTraceVector(Disassembler, Bus, ResetVector);
+        DisassemblerTraceVector(Disassembler, Bus, IrqVector);
     }
-    return ValidAddress;
 }
 
+// NOTE: Start of the known instruction that ends right at Address, or the
+//       byte before it as data when the previous start does not
 internal u16
-StepBackToInstruction(u16 Address, u8** DisassemledInstructions, i32 Steps) {
-    u16 SteppedBackAddress = Address;
-    for (i32 I = 0; I < Steps; I++) {
-        SteppedBackAddress = FindPreviousAddress(SteppedBackAddress, DisassemledInstructions);
+DisassemblerPreviousAddress(disassembler* Disassembler, bus* Bus, u16 Address, bool32* Data) {
+    u32 Rank = DisassemblerRank(Disassembler, Address);
+    if (Rank) {
+        u16 Previous = DisassemblerSelect(Disassembler, Rank - 1);
+        if ((u16)(Previous + Disassembler->Decoded[Previous].Length) == Address &&
+            DisassemblerIsInstruction(Disassembler, Bus, Previous)) {
+            *Data = 0;
+            return Previous;
+        }
     }
-    return SteppedBackAddress;
+    *Data = 1;
+    return Address - 1;
+}
+
+internal u8*
+DisassemblerRowText(disassembler* Disassembler, bus* Bus, u16 Address, bool32 Data) {
+    u8 Bytes[3];
+    i32 Size = Data ? 1 : DisassemblerInstructionSize(Disassembler, Bus, Address);
+    for (i32 ByteIndex = 0; ByteIndex < Size; ByteIndex++) {
+        Bytes[ByteIndex] = BusPeek(Bus, Address + ByteIndex);
+    }
+
+    disassembly_row* Row = Disassembler->Rows + (Address % DisassemblyRowCacheCount);
+    if (Row->Valid && Row->Address == Address && Row->Data == Data &&
+        memcmp(Row->Bytes, Bytes, Size) == 0) {
+        return Row->Text;
+    }
+
+    if (Data) {
+        sprintf(Row->Text, "%04X: (%02X)         .DB $%02X\0", Address, Bytes[0], Bytes[0]);
+    } else {
+        FormatDisassembledInstruction(Address, Bytes[0], Bus, Disassembler->InstructionsDict, Row->Text);
+    }
+    memcpy(Row->Bytes, Bytes, Size);
+    Row->Address = Address;
+    Row->Data = Data;
+    Row->Valid = 1;
+    return Row->Text;
 }
 
 #define AroundInstructionCount (3)
@@ -1033,29 +1230,36 @@ internal void
 DrawCode(pixel_buffer* Dest,
          i32 CellX, i32 CellY,
          u16 Address, bus* Bus,
-         u8** DisassemledInstructions) {
-    // NOTE: This assertions work on SMB
-    // Assert(FindPreviousAddress(0x8004, DisassemledInstructions) == 0x8002);
-    // Assert(FindPreviousAddress(0x8002, DisassemledInstructions) == 0x8001);
-    // Assert(FindPreviousAddress(0x8001, DisassemledInstructions) == 0x8000);
-    // Assert(StepBackToInstruction(0x8004, DisassemledInstructions, 3) == 0x8000);
+         disassembler* Disassembler) {
+    DisassemblerUpdate(Disassembler, Bus);
+    DisassemblerSyncLog(Disassembler, Bus, Address);
+    if (!DisassemblerIsInstruction(Disassembler, Bus, Address)) {
+        DisassemblerTrace(Disassembler, Bus, Address);
+    }
+    if (Disassembler->RankStale) {
+        DisassemblerBuildRank(Disassembler);
+    }
 
-    u16 ExecutingAddress = FindValidAddress(Address, DisassemledInstructions);
-    u16 StartAddress = StepBackToInstruction(ExecutingAddress, DisassemledInstructions, AroundInstructionCount);
+    u16 RowAddress[AroundInstructionCount];
+    bool32 RowData[AroundInstructionCount];
+    u16 CurrentAddress = Address;
+    for (i32 Row = AroundInstructionCount - 1; Row >= 0; Row--) {
+        CurrentAddress = DisassemblerPreviousAddress(Disassembler, Bus, CurrentAddress, RowData + Row);
+        RowAddress[Row] = CurrentAddress;
+    }
 
-    u16 CurrentAddress = StartAddress;
-    i32 NumberOfInstructionsToPrint = (AroundInstructionCount * 2) + 1;
-    i32 CellYOffset = 0;
-    while (NumberOfInstructionsToPrint) {
-        if (DisassemledInstructions[CurrentAddress]) {
-            if (CurrentAddress == ExecutingAddress) {
-                PutChar(Dest, CellX, CellY + CellYOffset, '>');
-            }
-            PrintToPixelBuffer(Dest, CellX + 1, CellY + CellYOffset, DisassemledInstructions[CurrentAddress]);
-            NumberOfInstructionsToPrint--;
-            CellYOffset++;
-            CurrentAddress = FindNextAddress(CurrentAddress, DisassemledInstructions);
-        }
+    for (i32 Row = 0; Row < AroundInstructionCount; Row++) {
+        PrintToPixelBuffer(Dest, CellX + 1, CellY + Row,
+                           DisassemblerRowText(Disassembler, Bus, RowAddress[Row], RowData[Row]));
+    }
+
+    // NOTE: From PC on rows are decoded in memory order, whatever the log says
+    CurrentAddress = Address;
+    PutChar(Dest, CellX, CellY + AroundInstructionCount, '>');
+    for (i32 Row = AroundInstructionCount; Row < (AroundInstructionCount * 2) + 1; Row++) {
+        PrintToPixelBuffer(Dest, CellX + 1, CellY + Row,
+                           DisassemblerRowText(Disassembler, Bus, CurrentAddress, 0));
+        CurrentAddress += DisassemblerInstructionSize(Disassembler, Bus, CurrentAddress);
     }
 }
 
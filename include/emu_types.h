@@ -2,24 +2,62 @@
 #define _EMU_TYPES_H
 
 #include "base.h"
+#include "gfx.h"
+
+#include <stdio.h>
 
 typedef enum mirroring {
     Horizontal,
     Vertical,
+    SingleScreenLow,
+    SingleScreenHigh,
 } mirroring;
 
 typedef struct rom {
-    u8 PrgRomBankCount;
-    u8 ChrRomBankCount;
+    u32 PrgRomBankCount;
+    u32 ChrRomBankCount;
     u32 MapperId;
+    u32 SubmapperId;
     mirroring Mirroring;
     bool32 IgnoreMirroring;
     bool32 HasPrgRam;
+    bool32 HasBattery;
+    // NOTE: Set when NES 2.0 or the database give the PRG-RAM size, iNES 1.0
+    //       headers leave it to the mapper
+    bool32 PrgRamSizeKnown;
+    u32 PrgRamBytes;
     bool32 HasTrainer;
+    bool32 HasChrRam;
+    bool32 Nes20;
+    // NOTE: CRC-32 of PRG-ROM and CHR-ROM, the database key
+    u32 Crc32;
+    bool32 InDatabase;
     u8* Prg;
     u8* Chr;
 } rom;
 
+// NOTE: Mapper registers, part of the machine state. Bank pointers are
+//       derived from them (MapperMapMemory), so only these need saving.
+typedef struct mapper {
+    mirroring Mirroring;
+    // NOTE: MMC1: control, CHR 0, CHR 1, PRG. MMC3: R0-R7. Others: R0 is
+    //       the last value written.
+    u8 Registers[8];
+    // NOTE: MMC1 serial port, ShiftClock is the master clock of the last
+    //       write it took
+    u8 Shift;
+    u8 ShiftCount;
+    u64 ShiftClock;
+    // NOTE: MMC3 bank select and scanline IRQ
+    u8 BankSelect;
+    u8 IrqLatch;
+    u8 IrqCounter;
+    bool32 IrqReload;
+    bool32 IrqEnabled;
+    bool32 IrqLine;
+    u64 IrqClock;
+} mapper;
+
 typedef struct status_register {
     u8 VerticalBlank;
     u8 SpriteZeroHit;
@@ -36,32 +74,152 @@ typedef struct ppu {
     i32 Dot;
     i32 Scanline;
     bool32 FrameComplete;
+    bool32 NmiOutput;
+    // NOTE: Rising edge latch for the instruction-stepped CPU core
+    bool32 NmiPending;
+    u64 NmiDot;
+    // NOTE: Address is the current VRAM address (v), TempAddress is t and
+    //       AddressLatch is the shared $2005/$2006 write toggle (w).
+    //       Layout of both: 0yyy NNYY YYYX XXXX (fine Y, nametable, coarse Y/X).
     u8 AddressLatch;
     u16 TempAddress;
     u16 Address;
+    u8 FineX;
     u8 Control;
     u8 Mask;
     status_register Status;
     oam Oam;
     u8 NameTable[2][1024];
+    u8 Palette[32];
+    // NOTE: Background pixels of the current scanline already drawn, and the
+    //       pixel where Address starts applying (moves on mid-line $2006 writes)
+    i32 LineX;
+    i32 LineOriginX;
 } ppu;
 
-typedef struct ppu_pixel {
-    u32 Color;
-    i32 X;
-    i32 Y;
-} ppu_pixel;
+#define ChrTileCount      (512)
+#define ChrTilePixelCount (64)
+
+// NOTE: Both pattern tables decoded to one byte (0-3) per pixel. A tile is
+//       decoded again on first use after its CHR bytes changed. Version goes
+//       up on every invalidation of a tile, Generation on any invalidation,
+//       so viewers can tell what changed since they last looked.
+typedef struct chr_cache {
+    u8 Pixels[ChrTileCount][ChrTilePixelCount];
+    u8 Dirty[ChrTileCount];
+    u32 Version[ChrTileCount];
+    u32 Generation;
+} chr_cache;
 
 typedef enum pattern_table_half {
     Left,
     Right,
 } pattern_table_half;
 
-typedef struct bus {
-    u32 TickCount;
+// NOTE: Everything that changes what the CPU can observe gets an event,
+//       the CPU runs in bursts between them and the PPU catches up lazily.
+typedef enum scheduler_event {
+    SchedulerEvent_VBlankStart,
+    SchedulerEvent_VBlankEnd,
+    SchedulerEvent_FrameEnd,
+    SchedulerEvent_MapperIrq,
+    SchedulerEvent_Count,
+} scheduler_event;
+
+// NOTE: Accurate core is the cycle-stepped m6502, fast core steps whole
+//       instructions and only syncs with the rest of the machine on I/O.
+typedef enum cpu_core {
+    CpuCoreAccurate,
+    CpuCoreFast,
+} cpu_core;
+
+typedef struct scheduler {
+    cpu_core CpuCore;
+    // NOTE: Master clock counts PPU dots, CPU ticks on every third one
+    u64 MasterClock;
+    u64 PpuClock;
+    u64 EventClock[SchedulerEvent_Count];
+    // NOTE: Where the current CPU burst stops, pulled in when a write moves
+    //       an event closer
+    u64 BurstEnd;
+    // NOTE: Fetch clock right after a taken branch that stayed on its page,
+    //       the fast core polls NMI one cycle late there like the real CPU.
+    u64 FastCpuBranchClock;
+    // NOTE: Fetch clock right after CLI, SEI or PLP and the I flag from
+    //       before it. They change I after their IRQ poll, so the fast core
+    //       polls with the old flag there.
+    u64 FastCpuIrqFlagClock;
+    u8 FastCpuIrqFlag;
+} scheduler;
+
+typedef struct bus bus;
+
+typedef u8 bus_read_handler(bus* Bus, u16 Address);
+typedef void bus_write_handler(bus* Bus, u16 Address, u8 Value);
+typedef void bus_scanline_handler(bus* Bus);
+
+// NOTE: One entry per 256 byte page. Memory pointers point at the host memory
+//       for the first byte of the page, when they are 0 the handler is used.
+typedef struct bus_page {
+    u8* Read;
+    u8* Write;
+    bus_read_handler* ReadHandler;
+    bus_write_handler* WriteHandler;
+} bus_page;
+
+#define BusPageSize  (256)
+#define BusPageCount (256)
+
+// NOTE: Code/data log, one byte of flags per byte of RAM, PRG-RAM and
+//       PRG-ROM (CodeDataLogOffset), so every bank keeps its own flags
+//       however often it is switched. The CPU cores set Code on every
+//       opcode fetch.
+#define CodeDataLogCode      (0b00000001)
+
+// NOTE: One record per executed instruction, taken right before the opcode
+//       fetch. CPU cycle and PPU scanline/dot are derived from MasterClock
+//       offline (PPU is at -1:0 on clock 0 and frames have a fixed length).
+typedef struct trace_record {
+    u64 MasterClock;
+    u16 PC;
+    u8 OpCode;
+    u8 Operand[2];
+    u8 A;
+    u8 X;
+    u8 Y;
+    u8 S;
+    u8 P;
+    u8 Reserved[6];
+} trace_record;
+
+// NOTE: Ring of Capacity (power of two) records. With a Stream the ring is
+//       written out every time it is full, and the rest on TraceFlush.
+typedef struct trace_buffer {
+    trace_record* Records;
+    u32 Mask;
+    u64 Count;
+    u64 FlushedCount;
+    FILE* Stream;
+} trace_buffer;
+
+struct bus {
+    scheduler Scheduler;
+    pixel_buffer* Screen;
     rom* Rom;
     u8* Ram;
+    chr_cache* ChrCache;
+    u8* CodeDataLog;
+    trace_buffer* Trace;
     ppu* Ppu;
-} bus;
+    mapper* Mapper;
+    u8* PrgRam;
+    // NOTE: 1KB CHR banks for $0000-$1FFF and the four logical nametables
+    u8* ChrBanks[8];
+    u8* NameTables[4];
+    // NOTE: Mappers that count scanlines get called when the PPU is done
+    //       with dot 260 of a rendered line
+    bus_scanline_handler* ScanlineHandler;
+    bus_page Pages[BusPageCount];
+};
 
 #endif
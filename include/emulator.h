@@ -0,0 +1,203 @@
+#ifndef _EMU_EMULATOR_H
+#define _EMU_EMULATOR_H
+
+#include "base.h"
+#include "constants.h"
+#include "emu_types.h"
+#include "bus.h"
+#include "rom.h"
+#include "ppu.h"
+#include "mapper.h"
+#include "gfx.h"
+#include "profiler.h"
+#include "cpu_fast.h"
+#include "trace.h"
+
+#include "m6502.h"
+
+#include <string.h>
+
+// NOTE: Everything the emulated machine is made of besides the ROM, in one
+//       block so a save state is a memcpy (see save_state.h). The bus points
+//       into it. Scheduler stays inside the bus for the hot path and is
+//       saved next to the block.
+typedef struct machine_state {
+    m6502_t Cpu;
+    u64 Pins;
+    ppu Ppu;
+    mapper Mapper;
+    u8 Ram[RamSize];
+    u8 PrgRam[PrgRamSize];
+    u8 ChrRam[ChrBankSize];
+} machine_state;
+
+internal void
+MachineInit(machine_state* Machine, bus* Bus, rom* Rom) {
+    memset(Machine, 0, sizeof(*Machine));
+    Machine->Ppu = PpuInit();
+    MapperInit(&Machine->Mapper, Rom);
+    if (Rom->HasChrRam) {
+        Rom->Chr = Machine->ChrRam;
+    }
+
+    m6502_desc_t CpuDesc = {0};
+    CpuDesc.bcd_disabled = 1;
+    Machine->Pins = m6502_init(&Machine->Cpu, &CpuDesc);
+
+    Bus->Rom = Rom;
+    Bus->Ram = Machine->Ram;
+    Bus->Ppu = &Machine->Ppu;
+    Bus->Mapper = &Machine->Mapper;
+    Bus->PrgRam = MapperHasPrgRam(Rom) ? Machine->PrgRam : 0;
+}
+
+internal void
+SchedulerUpdateEvents(bus* Bus) {
+    // NOTE: PPU has to be caught up, events are derived from its position
+    scheduler* Scheduler = &Bus->Scheduler;
+    ppu* Ppu = Bus->Ppu;
+    Scheduler->EventClock[SchedulerEvent_VBlankStart] =
+        Scheduler->PpuClock + PpuTicksUntil(Ppu, PpuVblankStartScanline, 0);
+    Scheduler->EventClock[SchedulerEvent_VBlankEnd] =
+        Scheduler->PpuClock + PpuTicksUntil(Ppu, -1, 0);
+    Scheduler->EventClock[SchedulerEvent_FrameEnd] =
+        Scheduler->PpuClock + PpuTicksUntil(Ppu, PpuLastScanline, PpuDotPerScanline - 1);
+    Scheduler->EventClock[SchedulerEvent_MapperIrq] = MapperIrqEventClock(Bus);
+}
+
+internal void
+SchedulerInit(bus* Bus) {
+    Bus->Scheduler.MasterClock = 0;
+    Bus->Scheduler.PpuClock = 0;
+    SchedulerUpdateEvents(Bus);
+}
+
+internal u64
+SchedulerNextEventClock(scheduler* Scheduler) {
+    u64 Result = Scheduler->EventClock[0];
+    for (i32 EventIndex = 1; EventIndex < SchedulerEvent_Count; EventIndex++) {
+        if (Scheduler->EventClock[EventIndex] < Result) {
+            Result = Scheduler->EventClock[EventIndex];
+        }
+    }
+    return Result;
+}
+
+internal void
+CpuTick(m6502_t* Cpu, u64* Pins, bus* Bus) {
+    // NOTE: m6502 does its own edge detection on the pin
+    Bus->Ppu->NmiPending = 0;
+    if (Bus->Ppu->NmiOutput) {
+        *Pins = *Pins | M6502_NMI;
+    } else {
+        *Pins = *Pins & ~M6502_NMI;
+    }
+    if (Bus->Mapper->IrqLine) {
+        *Pins = *Pins | M6502_IRQ;
+    } else {
+        *Pins = *Pins & ~M6502_IRQ;
+    }
+
+    u64 PreviousPins = *Pins;
+    BeginTimedBlock(CpuCore);
+    *Pins = m6502_tick(Cpu, *Pins);
+    EndTimedBlock(CpuCore);
+
+    // NOTE: m6502 turns the last fetch into BRK when an interrupt is due
+    if ((PreviousPins & M6502_SYNC) && Bus->Trace &&
+        (Cpu->brk_flags & (M6502_BRK_IRQ | M6502_BRK_NMI))) {
+        TraceDropLast(Bus->Trace);
+    }
+
+    u16 Address = M6502_GET_ADDR(*Pins);
+    if (*Pins & M6502_SYNC) {
+        if (Bus->CodeDataLog) {
+            BusLogCode(Bus, Address);
+        }
+        if (Bus->Trace) {
+            TraceInstruction(Bus->Trace, Bus, Cpu, Address);
+        }
+    }
+    if (*Pins & M6502_RW) {
+        BeginTimedBlock(BusRead);
+        u8 MemoryValue = BusRead(Bus, Address);
+        BusPostRead(Bus, Address);
+        EndTimedBlock(BusRead);
+        M6502_SET_DATA(*Pins, MemoryValue);
+    } else {
+        u8 MemoryValueToWrite = M6502_GET_DATA(*Pins);
+        BeginTimedBlock(BusWrite);
+        BusWrite(Bus, Address, MemoryValueToWrite);
+        EndTimedBlock(BusWrite);
+        //TODO: Memory post-write
+    }
+}
+
+// NOTE: Runs the machine until TargetClock master ticks are done. Timing is the
+//       same as ticking the PPU every dot and the CPU every third dot, but the
+//       CPU runs in bursts up to the next event and the PPU only catches up on
+//       events, on $2000-$3FFF accesses and at the end.
+internal void
+EmulatorRunUntil(m6502_t* MachineCpu, u64* MachinePins, bus* Bus, u64 TargetClock) {
+    scheduler* Scheduler = &Bus->Scheduler;
+
+    // NOTE: CPU state is worked on in locals. Bus writes go through u8
+    //       pointers, so for state in memory the compiler has to assume
+    //       every write may change it and can't keep it in registers.
+    m6502_t LocalCpu = *MachineCpu;
+    u64 LocalPins = *MachinePins;
+    m6502_t* Cpu = &LocalCpu;
+    u64* Pins = &LocalPins;
+
+    while (Scheduler->MasterClock < TargetClock) {
+        u64 NextEventClock = SchedulerNextEventClock(Scheduler);
+        if (NextEventClock <= Scheduler->MasterClock) {
+            PpuCatchUpToCpu(Bus);
+            SchedulerUpdateEvents(Bus);
+            continue;
+        }
+
+        Scheduler->BurstEnd = (NextEventClock < TargetClock) ? NextEventClock : TargetClock;
+
+        u64 CpuClock = Scheduler->MasterClock + (CpuClockDivider - 1);
+        CpuClock -= CpuClock % CpuClockDivider;
+
+        if (Scheduler->CpuCore == CpuCoreFast) {
+            // NOTE: Whole instructions, the last one may run past BurstEnd
+            Scheduler->MasterClock = CpuClock;
+            BeginTimedBlock(CpuCore);
+            while (Scheduler->MasterClock < Scheduler->BurstEnd) {
+                FastCpuStep(Cpu, Bus);
+            }
+            EndTimedBlock(CpuCore);
+        } else {
+            while (CpuClock < Scheduler->BurstEnd) {
+                Scheduler->MasterClock = CpuClock;
+                CpuTick(Cpu, Pins, Bus);
+                CpuClock += CpuClockDivider;
+            }
+
+            Scheduler->MasterClock = Scheduler->BurstEnd;
+        }
+    }
+
+    PpuCatchUp(Bus, Scheduler->MasterClock);
+    SchedulerUpdateEvents(Bus);
+
+    *MachineCpu = LocalCpu;
+    *MachinePins = LocalPins;
+}
+
+internal void
+GlobalTick(m6502_t* Cpu, u64* Pins, bus* Bus) {
+    EmulatorRunUntil(Cpu, Pins, Bus, Bus->Scheduler.MasterClock + 1);
+}
+
+internal void
+GlobalFrame(m6502_t* Cpu, u64* Pins, bus* Bus) {
+    u64 FrameEndClock = Bus->Scheduler.EventClock[SchedulerEvent_FrameEnd];
+    EmulatorRunUntil(Cpu, Pins, Bus, FrameEndClock + 1);
+    Bus->Ppu->FrameComplete = 0;
+}
+
+#endif
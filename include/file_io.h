@@ -4,31 +4,189 @@
 #include "base.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// NOTE: Copied is set when the file could not be mapped and Data is a heap
+//       copy instead
 typedef struct loaded_file {
     u8* Data;
     size_t Size;
+    bool32 Copied;
 } loaded_file;
 
-internal loaded_file
-LoadFile(char* FileName, void* DestinationMemory) {
-    FILE* File = fopen(FileName, "rb");
-    Assert(File);
+internal bool32
+SaveFile(char* FileName, void* Data, size_t Size) {
+    FILE* File = fopen(FileName, "wb");
+    if (!File) {
+        return 0;
+    }
 
-    i32 CurrentByte;
+    size_t Written = fwrite(Data, 1, Size, File);
+    fclose(File);
 
-    loaded_file Result;
+    return Written == Size;
+}
 
-    Result.Data = (u8*)DestinationMemory;
-    Result.Size = 0;
+// NOTE: Read-only view of a whole file, Data is 0 when it can't be opened
+//       or is empty. Mapped pages are shared with every other process
+//       mapping the same file and only paged in when touched. Where mapping
+//       fails the file is read into heap memory in one go. Has to be released
+//       with UnmapFile.
+internal loaded_file
+MapFile(char* FileName) {
+    loaded_file Result = {0};
+#if defined(_WIN32)
+    HANDLE File = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, 0,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (File == INVALID_HANDLE_VALUE) {
+        return Result;
+    }
+    LARGE_INTEGER FileSize;
+    if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart > 0) {
+        size_t Size = (size_t)FileSize.QuadPart;
+        HANDLE Mapping = CreateFileMappingA(File, 0, PAGE_READONLY, 0, 0, 0);
+        if (Mapping) {
+            Result.Data = (u8*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+            Result.Size = Result.Data ? Size : 0;
+            CloseHandle(Mapping);
+        }
+        if (!Result.Data && FileSize.QuadPart <= 0xFFFFFFFF) {
+            u8* Data = (u8*)malloc(Size);
+            DWORD ReadSize = 0;
+            if (Data && ReadFile(File, Data, (DWORD)Size, &ReadSize, 0) && ReadSize == Size) {
+                Result.Data = Data;
+                Result.Size = Size;
+                Result.Copied = 1;
+            } else {
+                free(Data);
+            }
+        }
+    }
+    CloseHandle(File);
+#else
+    int File = open(FileName, O_RDONLY);
+    if (File < 0) {
+        return Result;
+    }
+    struct stat FileStat;
+    if (fstat(File, &FileStat) == 0 && FileStat.st_size > 0) {
+        size_t Size = (size_t)FileStat.st_size;
+        void* Data = mmap(0, Size, PROT_READ, MAP_SHARED, File, 0);
+        if (Data != MAP_FAILED) {
+            Result.Data = (u8*)Data;
+            Result.Size = Size;
+        } else {
+            u8* Copy = (u8*)malloc(Size);
+            size_t ReadSize = 0;
+            while (Copy && ReadSize < Size) {
+                ssize_t Count = read(File, Copy + ReadSize, Size - ReadSize);
+                if (Count <= 0) {
+                    break;
+                }
+                ReadSize += (size_t)Count;
+            }
+            if (Copy && ReadSize == Size) {
+                Result.Data = Copy;
+                Result.Size = Size;
+                Result.Copied = 1;
+            } else {
+                free(Copy);
+            }
+        }
+    }
+    close(File);
+#endif
+    return Result;
+}
 
-    while ((CurrentByte = fgetc(File)) != EOF) {
-        Result.Data[Result.Size++] = (u8)CurrentByte;
+// NOTE: Writable view of a file of Size bytes, created or extended (zero
+//       filled) as needed. A larger file is refused rather than cut, it
+//       isn't what the caller expects. Writes go to the file through
+//       the page cache, they survive the process but not the OS unless
+//       flushed (FlushMappedFile). Data is 0 when it can't be mapped, there
+//       is no copying fallback. Has to be released with UnmapFile.
+internal loaded_file
+MapFileWritable(char* FileName, size_t Size) {
+    loaded_file Result = {0};
+#if defined(_WIN32)
+    HANDLE File = CreateFileA(FileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, 0,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if (File == INVALID_HANDLE_VALUE) {
+        return Result;
+    }
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER NewSize;
+    NewSize.QuadPart = (LONGLONG)Size;
+    if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart <= NewSize.QuadPart &&
+        (FileSize.QuadPart == NewSize.QuadPart ||
+         (SetFilePointerEx(File, NewSize, 0, FILE_BEGIN) && SetEndOfFile(File)))) {
+        HANDLE Mapping = CreateFileMappingA(File, 0, PAGE_READWRITE, 0, (DWORD)Size, 0);
+        if (Mapping) {
+            Result.Data = (u8*)MapViewOfFile(Mapping, FILE_MAP_WRITE, 0, 0, Size);
+            Result.Size = Result.Data ? Size : 0;
+            CloseHandle(Mapping);
+        }
+    }
+    CloseHandle(File);
+#else
+    int File = open(FileName, O_RDWR | O_CREAT, 0644);
+    if (File < 0) {
+        return Result;
+    }
+    struct stat FileStat;
+    if (fstat(File, &FileStat) == 0 && (size_t)FileStat.st_size <= Size &&
+        ((size_t)FileStat.st_size == Size || ftruncate(File, (off_t)Size) == 0)) {
+        void* Data = mmap(0, Size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0);
+        if (Data != MAP_FAILED) {
+            Result.Data = (u8*)Data;
+            Result.Size = Size;
+        }
     }
+    close(File);
+#endif
+    return Result;
+}
 
-    fclose(File);
+// NOTE: Starts writing dirty pages of a MapFileWritable view back to disk.
+//       Wait blocks until they are written.
+internal void
+FlushMappedFile(loaded_file* File, bool32 Wait) {
+    if (!File->Data || File->Copied) {
+        return;
+    }
+#if defined(_WIN32)
+    Unused(Wait);
+    FlushViewOfFile(File->Data, File->Size);
+#else
+    msync(File->Data, File->Size, Wait ? MS_SYNC : MS_ASYNC);
+#endif
+}
 
-    return Result;
+internal void
+UnmapFile(loaded_file* File) {
+    if (File->Data) {
+        if (File->Copied) {
+            free(File->Data);
+        } else {
+#if defined(_WIN32)
+            UnmapViewOfFile(File->Data);
+#else
+            munmap(File->Data, File->Size);
+#endif
+        }
+    }
+    File->Data = 0;
+    File->Size = 0;
+    File->Copied = 0;
 }
 
 #endif
@@ -2,6 +2,27 @@
 #define _EMU_GFX_H
 
 #include "base.h"
+#include "pixel_kernels.h"
+
+#include <string.h>
+
+/*
+
+    Pixel buffer primitives. Everything is clipped against Dest, a rect
+    partly off either edge draws the part that is on it.
+
+    Row kernels have variants picked by PixelBufferKernelsInit like the
+    pixel kernels:
+
+    FillPixels: Count pixels set to one colour.
+    ScaleRow:   Count pixels, each repeated Scale times (nearest neighbour).
+                2x, 3x and 4x are shuffles, other scales use the scalar loop.
+
+    Blit rows are plain memcpy, the C library already has the best copy for
+    the host. A scaled blit builds each scaled row once and memcpys it into
+    the other Scale - 1 rows.
+
+*/
 
 typedef struct pixel_buffer {
     i32 Width;
@@ -9,22 +30,168 @@ typedef struct pixel_buffer {
     u32* Memory;
 } pixel_buffer;
 
+typedef void pixel_fill_kernel(u32* Dest, u32 Color, i32 Count);
+typedef void pixel_scale_kernel(u32* Dest, u32* Src, i32 Count, i32 Scale);
+
+typedef struct pixel_fill_variant {
+    char* Name;
+    pixel_fill_kernel* Kernel;
+    u32 Features;
+} pixel_fill_variant;
+
+typedef struct pixel_scale_variant {
+    char* Name;
+    pixel_scale_kernel* Kernel;
+    u32 Features;
+} pixel_scale_variant;
+
 internal void
-PixelBufferClear(pixel_buffer* Dest, u32 Color) {
-    u32* Row = Dest->Memory;
-    for (i32 Y = 0; Y < Dest->Height; Y++) {
-        u32* Pixel = Row;
-        for (i32 X = 0; X < Dest->Width; X++) {
-            *Pixel = Color;
-            Pixel++;
+FillPixelsScalar(u32* Dest, u32 Color, i32 Count) {
+    for (i32 PixelIndex = 0; PixelIndex < Count; PixelIndex++) {
+        Dest[PixelIndex] = Color;
+    }
+}
+
+internal void
+ScaleRowScalar(u32* Dest, u32* Src, i32 Count, i32 Scale) {
+    for (i32 PixelIndex = 0; PixelIndex < Count; PixelIndex++) {
+        u32 Color = Src[PixelIndex];
+        for (i32 Copy = 0; Copy < Scale; Copy++) {
+            *Dest++ = Color;
         }
-        Row += Dest->Width;
+    }
+}
+
+#if PIXEL_KERNELS_X86
+
+KernelTarget("sse2") internal void
+FillPixelsSse2(u32* Dest, u32 Color, i32 Count) {
+    __m128i Pixels = _mm_set1_epi32((int)Color);
+    i32 PixelIndex = 0;
+    for (; PixelIndex + 16 <= Count; PixelIndex += 16) {
+        __m128i* Row = (__m128i*)(Dest + PixelIndex);
+        _mm_storeu_si128(Row + 0, Pixels);
+        _mm_storeu_si128(Row + 1, Pixels);
+        _mm_storeu_si128(Row + 2, Pixels);
+        _mm_storeu_si128(Row + 3, Pixels);
+    }
+    for (; PixelIndex + 4 <= Count; PixelIndex += 4) {
+        _mm_storeu_si128((__m128i*)(Dest + PixelIndex), Pixels);
+    }
+
+    FillPixelsScalar(Dest + PixelIndex, Color, Count - PixelIndex);
+}
+
+KernelTarget("avx2") internal void
+FillPixelsAvx2(u32* Dest, u32 Color, i32 Count) {
+    __m256i Pixels = _mm256_set1_epi32((int)Color);
+    i32 PixelIndex = 0;
+    for (; PixelIndex + 32 <= Count; PixelIndex += 32) {
+        __m256i* Row = (__m256i*)(Dest + PixelIndex);
+        _mm256_storeu_si256(Row + 0, Pixels);
+        _mm256_storeu_si256(Row + 1, Pixels);
+        _mm256_storeu_si256(Row + 2, Pixels);
+        _mm256_storeu_si256(Row + 3, Pixels);
+    }
+    for (; PixelIndex + 8 <= Count; PixelIndex += 8) {
+        _mm256_storeu_si256((__m256i*)(Dest + PixelIndex), Pixels);
+    }
+
+    FillPixelsScalar(Dest + PixelIndex, Color, Count - PixelIndex);
+}
+
+KernelTarget("sse2") internal void
+ScaleRowSse2(u32* Dest, u32* Src, i32 Count, i32 Scale) {
+    // NOTE: 4 source pixels per step, every output register is one dword
+    //       shuffle of them (abcd -> aaab bbcc cddd for 3x)
+    i32 PixelIndex = 0;
+    if (Scale == 2) {
+        for (; PixelIndex + 4 <= Count; PixelIndex += 4) {
+            __m128i Pixels = _mm_loadu_si128((__m128i*)(Src + PixelIndex));
+            __m128i* Row = (__m128i*)(Dest + (PixelIndex * 2));
+            _mm_storeu_si128(Row + 0, _mm_unpacklo_epi32(Pixels, Pixels));
+            _mm_storeu_si128(Row + 1, _mm_unpackhi_epi32(Pixels, Pixels));
+        }
+    } else if (Scale == 3) {
+        for (; PixelIndex + 4 <= Count; PixelIndex += 4) {
+            __m128i Pixels = _mm_loadu_si128((__m128i*)(Src + PixelIndex));
+            __m128i* Row = (__m128i*)(Dest + (PixelIndex * 3));
+            _mm_storeu_si128(Row + 0, _mm_shuffle_epi32(Pixels, _MM_SHUFFLE(1, 0, 0, 0)));
+            _mm_storeu_si128(Row + 1, _mm_shuffle_epi32(Pixels, _MM_SHUFFLE(2, 2, 1, 1)));
+            _mm_storeu_si128(Row + 2, _mm_shuffle_epi32(Pixels, _MM_SHUFFLE(3, 3, 3, 2)));
+        }
+    } else if (Scale == 4) {
+        for (; PixelIndex + 4 <= Count; PixelIndex += 4) {
+            __m128i Pixels = _mm_loadu_si128((__m128i*)(Src + PixelIndex));
+            __m128i* Row = (__m128i*)(Dest + (PixelIndex * 4));
+            _mm_storeu_si128(Row + 0, _mm_shuffle_epi32(Pixels, _MM_SHUFFLE(0, 0, 0, 0)));
+            _mm_storeu_si128(Row + 1, _mm_shuffle_epi32(Pixels, _MM_SHUFFLE(1, 1, 1, 1)));
+            _mm_storeu_si128(Row + 2, _mm_shuffle_epi32(Pixels, _MM_SHUFFLE(2, 2, 2, 2)));
+            _mm_storeu_si128(Row + 3, _mm_shuffle_epi32(Pixels, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+    }
+
+    ScaleRowScalar(Dest + (PixelIndex * Scale), Src + PixelIndex, Count - PixelIndex, Scale);
+}
+
+#endif
+
+global_variable pixel_fill_variant PixelFillVariants[] = {
+    {"scalar", FillPixelsScalar, 0},
+#if PIXEL_KERNELS_X86
+    {"sse2", FillPixelsSse2, CpuSse2},
+    {"avx2", FillPixelsAvx2, CpuAvx2},
+#endif
+};
+
+global_variable pixel_scale_variant PixelScaleVariants[] = {
+    {"scalar", ScaleRowScalar, 0},
+#if PIXEL_KERNELS_X86
+    {"sse2", ScaleRowSse2, CpuSse2},
+#endif
+};
+
+global_variable pixel_fill_kernel* FillPixels = FillPixelsScalar;
+global_variable pixel_scale_kernel* ScaleRow = ScaleRowScalar;
+global_variable char* FillPixelsName = "scalar";
+global_variable char* ScaleRowName = "scalar";
+
+internal void
+PixelBufferKernelsInit(void) {
+    pixel_fill_variant* Fill = SelectKernelVariant(PixelFillVariants);
+    FillPixels = Fill->Kernel;
+    FillPixelsName = Fill->Name;
+
+    pixel_scale_variant* Scale = SelectKernelVariant(PixelScaleVariants);
+    ScaleRow = Scale->Kernel;
+    ScaleRowName = Scale->Name;
+}
+
+internal void
+PixelBufferClear(pixel_buffer* Dest, u32 Color) {
+    FillPixels(Dest->Memory, Color, Dest->Width * Dest->Height);
+}
+
+internal void
+PixelBufferFillRect(pixel_buffer* Dest, i32 X, i32 Y, i32 Width, i32 Height, u32 Color) {
+    i32 Left = (X < 0) ? 0 : X;
+    i32 Top = (Y < 0) ? 0 : Y;
+    i32 Right = (X + Width > Dest->Width) ? Dest->Width : X + Width;
+    i32 Bottom = (Y + Height > Dest->Height) ? Dest->Height : Y + Height;
+    if (Left >= Right || Top >= Bottom) {
+        return;
+    }
+
+    u32* DestRow = Dest->Memory + (Top * Dest->Width) + Left;
+    for (i32 DestY = Top; DestY < Bottom; DestY++) {
+        FillPixels(DestRow, Color, Right - Left);
+        DestRow += Dest->Width;
     }
 }
 
 internal void
 PixelBufferPutPixel(pixel_buffer* Screen, i32 X, i32 Y, u32 Color) {
-    if (X < 0 || Y < 0 || X > Screen->Width || Y > Screen->Height) {
+    if (X < 0 || Y < 0 || X >= Screen->Width || Y >= Screen->Height) {
         return;
     }
 
@@ -33,51 +200,71 @@ PixelBufferPutPixel(pixel_buffer* Screen, i32 X, i32 Y, u32 Color) {
 
 internal void
 PixelBufferBlit(pixel_buffer* Dest, pixel_buffer* Src, i32 X, i32 Y) {
-    //TODO: Clip Src to draw part of Pixel buffer
-
-    i32 SrcLeft = 0;
-    i32 SrcTop = 0;
-    i32 SrcRight = SrcLeft + Src->Width;
-    i32 SrcBottom = SrcTop + Src->Height;
-
-    if (X < 0) {
-        //SrcLeft -= X;
+    i32 Left = (X < 0) ? 0 : X;
+    i32 Top = (Y < 0) ? 0 : Y;
+    i32 Right = (X + Src->Width > Dest->Width) ? Dest->Width : X + Src->Width;
+    i32 Bottom = (Y + Src->Height > Dest->Height) ? Dest->Height : Y + Src->Height;
+    if (Left >= Right || Top >= Bottom) {
         return;
     }
 
-    if (X > (Dest->Width - Src->Width)) {
-        return;
+    u32* DestRow = Dest->Memory + (Top * Dest->Width) + Left;
+    u32* SrcRow = Src->Memory + ((Top - Y) * Src->Width) + (Left - X);
+    size_t RowSize = sizeof(u32) * (size_t)(Right - Left);
+    for (i32 DestY = Top; DestY < Bottom; DestY++) {
+        memcpy(DestRow, SrcRow, RowSize);
+        DestRow += Dest->Width;
+        SrcRow += Src->Width;
     }
+}
 
-    if (Y > (Dest->Height - Src->Height)) {
+// NOTE: Src drawn Scale times as big with its top left at X, Y
+internal void
+PixelBufferBlitScaled(pixel_buffer* Dest, pixel_buffer* Src, i32 X, i32 Y, i32 Scale) {
+    if (Scale <= 1) {
+        PixelBufferBlit(Dest, Src, X, Y);
         return;
     }
 
-    if (Y < 0) {
-        //SrcTop -= Y;
+    i32 Left = (X < 0) ? 0 : X;
+    i32 Top = (Y < 0) ? 0 : Y;
+    i32 Right = (X + (Src->Width * Scale) > Dest->Width) ? Dest->Width : X + (Src->Width * Scale);
+    i32 Bottom = (Y + (Src->Height * Scale) > Dest->Height) ? Dest->Height : Y + (Src->Height * Scale);
+    if (Left >= Right || Top >= Bottom) {
         return;
     }
 
-    i32 SrcPitch = SrcRight - SrcLeft;
-
-    u32* DestRow = Dest->Memory;
-    DestRow += Y * Dest->Width;
-    DestRow += X;
-
-    u32* SrcRow = Src->Memory;
-    SrcRow += SrcTop * Src->Width;
-    SrcRow += SrcLeft;
+    // NOTE: Clipping can cut into the first and last source pixel, those
+    //       get filled, whole pixels in between go through ScaleRow
+    i32 SrcLeft = (Left - X) / Scale;
+    i32 LeadCount = (Scale - ((Left - X) % Scale)) % Scale;
+    if (LeadCount > Right - Left) {
+        LeadCount = Right - Left;
+    }
+    i32 WholeCount = (Right - Left - LeadCount) / Scale;
+    i32 TailCount = (Right - Left) - LeadCount - (WholeCount * Scale);
+    i32 SrcWhole = SrcLeft + (LeadCount ? 1 : 0);
+    size_t RowSize = sizeof(u32) * (size_t)(Right - Left);
 
-    for (i32 SrcY = SrcTop; SrcY < SrcBottom; SrcY++) {
-        u32* DestPixel = DestRow;
-        u32* SrcPixel = SrcRow;
-        for (i32 SrcX = SrcLeft; SrcX < SrcRight; SrcX++) {
-            *DestPixel = *SrcPixel;
-            DestPixel++;
-            SrcPixel++;
+    u32* DestRow = Dest->Memory + (Top * Dest->Width) + Left;
+    i32 PreviousSrcY = -1;
+    for (i32 DestY = Top; DestY < Bottom; DestY++) {
+        i32 SrcY = (DestY - Y) / Scale;
+        if (SrcY == PreviousSrcY) {
+            memcpy(DestRow, DestRow - Dest->Width, RowSize);
+        } else {
+            u32* SrcRow = Src->Memory + (SrcY * Src->Width);
+            u32* DestPixel = DestRow;
+            FillPixels(DestPixel, SrcRow[SrcLeft], LeadCount);
+            DestPixel += LeadCount;
+            ScaleRow(DestPixel, SrcRow + SrcWhole, WholeCount, Scale);
+            DestPixel += WholeCount * Scale;
+            if (TailCount) {
+                FillPixels(DestPixel, SrcRow[SrcWhole + WholeCount], TailCount);
+            }
+            PreviousSrcY = SrcY;
         }
         DestRow += Dest->Width;
-        SrcRow += SrcPitch;
     }
 }
 
@@ -0,0 +1,175 @@
+#ifndef _EMU_LZ_H
+#define _EMU_LZ_H
+
+#include "base.h"
+
+#include <string.h>
+
+/*
+
+    Small LZ77 codec for save state deltas, block format close to LZ4:
+
+    sequence = token, [literal length bytes], literals, offset (u16 LE), [match length bytes]
+    token    = literal length (high nibble) | match length - LzMinMatch (low nibble)
+
+    A nibble of 15 is followed by bytes adding to it, 255 means another one
+    follows. The last sequence has literals only. Offsets are at most 65535
+    and matches may overlap their source, so runs of zeros (most of a XOR
+    delta) become one offset-1 match.
+
+*/
+
+#define LzMinMatch      (4)
+#define LzHashBits      (12)
+#define LzHashCount     (1 << LzHashBits)
+#define LzMaxOffset     (0xFFFF)
+
+// NOTE: Worst case output size for Size bytes of input
+#define LzBound(Size) ((Size) + ((Size) / 255) + 16)
+
+internal u32
+LzRead32(u8* Pointer) {
+    u32 Result;
+    memcpy(&Result, Pointer, sizeof(Result));
+    return Result;
+}
+
+internal u32
+LzHash(u32 Sequence) {
+    return (Sequence * 2654435761u) >> (32 - LzHashBits);
+}
+
+internal u8*
+LzWriteLength(u8* Output, u32 Length) {
+    while (Length >= 255) {
+        *Output++ = 255;
+        Length -= 255;
+    }
+    *Output++ = (u8)Length;
+    return Output;
+}
+
+internal u8*
+LzWriteSequence(u8* Output, u8* Literals, u32 LiteralCount, u32 Offset, u32 MatchLength) {
+    u32 MatchCode = MatchLength ? MatchLength - LzMinMatch : 0;
+    u8* Token = Output++;
+    *Token = (u8)(((LiteralCount < 15) ? LiteralCount : 15) << 4);
+    if (LiteralCount >= 15) {
+        Output = LzWriteLength(Output, LiteralCount - 15);
+    }
+    memcpy(Output, Literals, LiteralCount);
+    Output += LiteralCount;
+
+    if (MatchLength) {
+        *Token |= (u8)((MatchCode < 15) ? MatchCode : 15);
+        *Output++ = (u8)(Offset & 0xFF);
+        *Output++ = (u8)(Offset >> 8);
+        if (MatchCode >= 15) {
+            Output = LzWriteLength(Output, MatchCode - 15);
+        }
+    }
+    return Output;
+}
+
+// NOTE: Output has to hold LzBound(Size) bytes, returns the compressed size
+internal size_t
+LzCompress(u8* Output, u8* Input, size_t Size) {
+    u32 Table[LzHashCount];
+    memset(Table, 0, sizeof(Table));
+
+    u8* OutputStart = Output;
+    size_t Anchor = 0;
+    size_t Position = 0;
+    // NOTE: Table holds position + 1, 0 is empty
+    while (Position + LzMinMatch <= Size) {
+        u32 Sequence = LzRead32(Input + Position);
+        u32 Hash = LzHash(Sequence);
+        size_t Candidate = Table[Hash];
+        Table[Hash] = (u32)(Position + 1);
+
+        if (Candidate && (Position - (Candidate - 1)) <= LzMaxOffset &&
+            LzRead32(Input + Candidate - 1) == Sequence) {
+            size_t Source = Candidate - 1;
+            size_t MatchLength = LzMinMatch;
+            while (Position + MatchLength < Size &&
+                   Input[Source + MatchLength] == Input[Position + MatchLength]) {
+                MatchLength++;
+            }
+
+            Output = LzWriteSequence(Output, Input + Anchor, (u32)(Position - Anchor),
+                                     (u32)(Position - Source), (u32)MatchLength);
+            Position += MatchLength;
+            Anchor = Position;
+        } else {
+            // NOTE: Skip ahead faster on data that doesn't compress
+            Position += 1 + ((Position - Anchor) >> 6);
+        }
+    }
+
+    Output = LzWriteSequence(Output, Input + Anchor, (u32)(Size - Anchor), 0, 0);
+    return (size_t)(Output - OutputStart);
+}
+
+// NOTE: Returns the decompressed size, 0 on corrupt input or when it would
+//       not fit in Capacity
+internal size_t
+LzDecompress(u8* Output, size_t Capacity, u8* Input, size_t Size) {
+    u8* InputEnd = Input + Size;
+    size_t Written = 0;
+    while (Input < InputEnd) {
+        u8 Token = *Input++;
+
+        size_t LiteralCount = Token >> 4;
+        if (LiteralCount == 15) {
+            u8 Byte;
+            do {
+                if (Input >= InputEnd) {
+                    return 0;
+                }
+                Byte = *Input++;
+                LiteralCount += Byte;
+            } while (Byte == 255);
+        }
+        if (LiteralCount > (size_t)(InputEnd - Input) || LiteralCount > Capacity - Written) {
+            return 0;
+        }
+        memcpy(Output + Written, Input, LiteralCount);
+        Input += LiteralCount;
+        Written += LiteralCount;
+
+        if (Input == InputEnd) {
+            break;
+        }
+
+        if (InputEnd - Input < 2) {
+            return 0;
+        }
+        size_t Offset = Input[0] | (Input[1] << 8);
+        Input += 2;
+        size_t MatchLength = (Token & 0x0F);
+        if (MatchLength == 15) {
+            u8 Byte;
+            do {
+                if (Input >= InputEnd) {
+                    return 0;
+                }
+                Byte = *Input++;
+                MatchLength += Byte;
+            } while (Byte == 255);
+        }
+        MatchLength += LzMinMatch;
+        if (!Offset || Offset > Written || MatchLength > Capacity - Written) {
+            return 0;
+        }
+
+        u8* Source = Output + Written - Offset;
+        u8* Destination = Output + Written;
+        for (size_t Index = 0; Index < MatchLength; Index++) {
+            Destination[Index] = Source[Index];
+        }
+        Written += MatchLength;
+    }
+    return Written;
+}
+
+#endif
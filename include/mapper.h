@@ -0,0 +1,365 @@
+#ifndef _EMU_MAPPER_H
+#define _EMU_MAPPER_H
+
+#include "base.h"
+#include "constants.h"
+#include "emu_types.h"
+#include "bus.h"
+#include "rom.h"
+#include "ppu.h"
+
+#include <string.h>
+
+/*
+
+    Cartridge mappers: NROM (0), MMC1 (1), UxROM (2), CNROM (3), MMC3 (4)
+    and AxROM (7).
+
+    PRG goes in 8KB slots at $8000/$A000/$C000/$E000 straight into the bus
+    pages, CHR in 1KB slots (Bus->ChrBanks) and the nametables through
+    Bus->NameTables. Only the registers are machine state. A register write
+    decodes them to bank numbers again and only slots whose memory moved get
+    new pointers, CHR slots that moved are invalidated in the CHR cache.
+
+    MMC3 counts scanlines as with the usual setup (background tiles at $0000,
+    sprites at $1000): once per rendered line, when the PPU is done with dot
+    260. Its IRQ is a scheduler event at the line the counter runs out on.
+
+*/
+
+#define MapperPrgSlotSize  (1024 * 8)
+#define MapperPrgSlotCount (4)
+#define MapperChrSlotSize  (1024)
+#define MapperChrSlotCount (8)
+#define MapperNoIrq        (~0ULL)
+
+// NOTE: MMC1 control register
+#define Mmc1MirroringMask  (0b00000011)
+#define Mmc1PrgModeMask    (0b00001100)
+#define Mmc1PrgModeOffset  (2)
+#define Mmc1ChrMode4K      (0b00010000)
+#define Mmc1ShiftReset     (0b10000000)
+
+// NOTE: MMC3 bank select
+#define Mmc3RegisterMask   (0b00000111)
+#define Mmc3PrgMode        (0b01000000)
+#define Mmc3ChrInversion   (0b10000000)
+
+// NOTE: AxROM register
+#define AxRomPrgMask       (0b00000111)
+#define AxRomNametable     (0b00010000)
+
+internal bool32
+MapperHasPrgRam(rom* Rom) {
+    return Rom->HasPrgRam ||
+           (!Rom->PrgRamSizeKnown && (Rom->MapperId == MapperMMC1 || Rom->MapperId == MapperMMC3));
+}
+
+internal void
+MapperInit(mapper* Mapper, rom* Rom) {
+    memset(Mapper, 0, sizeof(*Mapper));
+    Mapper->Mirroring = Rom->Mirroring;
+    if (Rom->MapperId == MapperMMC1) {
+        // NOTE: Powers up with the last bank fixed at $C000
+        Mapper->Registers[0] = Mmc1PrgModeMask;
+    } else if (Rom->MapperId == MapperMMC3) {
+        u8 Registers[8] = {0, 2, 4, 5, 6, 7, 0, 1};
+        memcpy(Mapper->Registers, Registers, sizeof(Registers));
+    }
+}
+
+// NOTE: Bank numbers for each slot, PRG in 8KB and CHR in 1KB units. Not
+//       wrapped to the cartridge size yet.
+internal void
+MapperDecodeBanks(rom* Rom, mapper* Mapper,
+                  u32 PrgBanks[MapperPrgSlotCount],
+                  u32 ChrBanks[MapperChrSlotCount]) {
+    u32 LastPrgBank = (Rom->PrgRomBankCount * 2) - 1;
+    u8* Registers = Mapper->Registers;
+
+    for (u32 Slot = 0; Slot < MapperPrgSlotCount; Slot++) {
+        PrgBanks[Slot] = Slot;
+    }
+    for (u32 Slot = 0; Slot < MapperChrSlotCount; Slot++) {
+        ChrBanks[Slot] = Slot;
+    }
+
+    switch (Rom->MapperId) {
+        case MapperMMC1: {
+            u8 Control = Registers[0];
+            u32 PrgMode = (Control & Mmc1PrgModeMask) >> Mmc1PrgModeOffset;
+            u32 PrgBank = (Registers[3] & 0x0F) * 2;
+            if (PrgMode <= 1) {
+                u32 Base = PrgBank & ~0b11;
+                PrgBanks[0] = Base;
+                PrgBanks[1] = Base + 1;
+                PrgBanks[2] = Base + 2;
+                PrgBanks[3] = Base + 3;
+            } else if (PrgMode == 2) {
+                PrgBanks[0] = 0;
+                PrgBanks[1] = 1;
+                PrgBanks[2] = PrgBank;
+                PrgBanks[3] = PrgBank + 1;
+            } else {
+                PrgBanks[0] = PrgBank;
+                PrgBanks[1] = PrgBank + 1;
+                PrgBanks[2] = LastPrgBank - 1;
+                PrgBanks[3] = LastPrgBank;
+            }
+
+            for (u32 Slot = 0; Slot < MapperChrSlotCount; Slot++) {
+                if (Control & Mmc1ChrMode4K) {
+                    ChrBanks[Slot] = (Registers[1 + (Slot >> 2)] * 4) + (Slot & 0b11);
+                } else {
+                    ChrBanks[Slot] = ((Registers[1] & ~1) * 4) + Slot;
+                }
+            }
+        } break;
+        case MapperUxROM: {
+            PrgBanks[0] = Registers[0] * 2;
+            PrgBanks[1] = (Registers[0] * 2) + 1;
+            PrgBanks[2] = LastPrgBank - 1;
+            PrgBanks[3] = LastPrgBank;
+        } break;
+        case MapperCNROM: {
+            for (u32 Slot = 0; Slot < MapperChrSlotCount; Slot++) {
+                ChrBanks[Slot] = (Registers[0] * 8) + Slot;
+            }
+        } break;
+        case MapperMMC3: {
+            u32 SecondLastPrgBank = LastPrgBank - 1;
+            u32 R6 = Registers[6] & 0x3F;
+            u32 R7 = Registers[7] & 0x3F;
+            if (Mapper->BankSelect & Mmc3PrgMode) {
+                PrgBanks[0] = SecondLastPrgBank;
+                PrgBanks[2] = R6;
+            } else {
+                PrgBanks[0] = R6;
+                PrgBanks[2] = SecondLastPrgBank;
+            }
+            PrgBanks[1] = R7;
+            PrgBanks[3] = LastPrgBank;
+
+            // NOTE: R0/R1 are 2KB banks, inversion swaps the two pattern tables
+            u32 Banks[MapperChrSlotCount] = {
+                Registers[0] & ~1, Registers[0] | 1,
+                Registers[1] & ~1, Registers[1] | 1,
+                Registers[2], Registers[3], Registers[4], Registers[5],
+            };
+            u32 Inversion = (Mapper->BankSelect & Mmc3ChrInversion) ? 4 : 0;
+            for (u32 Slot = 0; Slot < MapperChrSlotCount; Slot++) {
+                ChrBanks[Slot] = Banks[Slot ^ Inversion];
+            }
+        } break;
+        case MapperAxROM: {
+            u32 Base = (Registers[0] & AxRomPrgMask) * 4;
+            for (u32 Slot = 0; Slot < MapperPrgSlotCount; Slot++) {
+                PrgBanks[Slot] = Base + Slot;
+            }
+        } break;
+        default: break;
+    }
+}
+
+internal u64
+MapperIrqEventClock(bus* Bus) {
+    mapper* Mapper = Bus->Mapper;
+    if (Bus->Rom->MapperId != MapperMMC3 || !Mapper->IrqEnabled) {
+        return MapperNoIrq;
+    }
+
+    // NOTE: Scanline clocks until the counter is 0 after one
+    u64 ClockCount = Mapper->IrqCounter;
+    if (Mapper->IrqReload || !Mapper->IrqCounter) {
+        ClockCount = Mapper->IrqLatch ? (u64)Mapper->IrqLatch + 1 : 1;
+    }
+
+    // NOTE: Assumes rendering stays on. If it doesn't the event comes early
+    //       and is moved on, it is never late.
+    ppu* Ppu = Bus->Ppu;
+    i64 Line = Ppu->Scanline;
+    u64 FrameOffset = 0;
+    if (Ppu->Dot > PpuScanlineCounterDot) {
+        Line++;
+    }
+    if (Line >= NesScreenHeight) {
+        Line = -1;
+        FrameOffset = PpuFrameDotCount;
+    }
+
+    u64 ClockedLineCount = NesScreenHeight + 1;
+    u64 LineIndex = (u64)(Line + 1) + (ClockCount - 1);
+    u64 Target = FrameOffset +
+                 ((LineIndex / ClockedLineCount) * PpuFrameDotCount) +
+                 ((LineIndex % ClockedLineCount) * PpuDotPerScanline) +
+                 PpuScanlineCounterDot + 1;
+    u64 Current = ((Ppu->Scanline + 1) * PpuDotPerScanline) + Ppu->Dot;
+    return Bus->Scheduler.PpuClock + (Target - Current);
+}
+
+internal void
+MapperScheduleIrq(bus* Bus) {
+    scheduler* Scheduler = &Bus->Scheduler;
+    u64 IrqClock = MapperIrqEventClock(Bus);
+    Scheduler->EventClock[SchedulerEvent_MapperIrq] = IrqClock;
+    if (IrqClock < Scheduler->BurstEnd) {
+        Scheduler->BurstEnd = IrqClock;
+    }
+}
+
+internal void
+Mmc3Scanline(bus* Bus) {
+    mapper* Mapper = Bus->Mapper;
+    if (!Mapper->IrqCounter || Mapper->IrqReload) {
+        Mapper->IrqCounter = Mapper->IrqLatch;
+        Mapper->IrqReload = 0;
+    } else {
+        Mapper->IrqCounter--;
+    }
+
+    if (!Mapper->IrqCounter && Mapper->IrqEnabled && !Mapper->IrqLine) {
+        Mapper->IrqLine = 1;
+        Mapper->IrqClock = Bus->Scheduler.PpuClock;
+    }
+}
+
+// NOTE: Points PRG pages, CHR slots and nametables at what the registers
+//       select. Cheap when nothing moved. PRG page handlers are set up by
+//       BusMapMemory.
+internal void
+MapperMapMemory(bus* Bus) {
+    rom* Rom = Bus->Rom;
+    mapper* Mapper = Bus->Mapper;
+
+    u32 PrgBanks[MapperPrgSlotCount];
+    u32 ChrBanks[MapperChrSlotCount];
+    MapperDecodeBanks(Rom, Mapper, PrgBanks, ChrBanks);
+
+    u32 PrgBankCount = Rom->PrgRomBankCount * 2;
+    for (u32 Slot = 0; Slot < MapperPrgSlotCount; Slot++) {
+        u8* Bank = Rom->Prg + ((PrgBanks[Slot] % PrgBankCount) * MapperPrgSlotSize);
+        u32 FirstPage = 0x80 + (Slot * (MapperPrgSlotSize / BusPageSize));
+        if (Bus->Pages[FirstPage].Read == Bank) {
+            continue;
+        }
+        for (u32 Page = 0; Page < (MapperPrgSlotSize / BusPageSize); Page++) {
+            Bus->Pages[FirstPage + Page].Read = Bank + (Page * BusPageSize);
+        }
+    }
+
+    u32 ChrBankCount = Rom->HasChrRam ? MapperChrSlotCount : (Rom->ChrRomBankCount * MapperChrSlotCount);
+    for (u32 Slot = 0; Slot < MapperChrSlotCount; Slot++) {
+        u8* Bank = Rom->Chr + ((ChrBanks[Slot] % ChrBankCount) * MapperChrSlotSize);
+        if (Bus->ChrBanks[Slot] != Bank) {
+            Bus->ChrBanks[Slot] = Bank;
+            if (Bus->ChrCache) {
+                ChrCacheInvalidate(Bus->ChrCache, (u16)(Slot * MapperChrSlotSize), MapperChrSlotSize);
+            }
+        }
+    }
+
+    // NOTE: Physical table for each logical one, by mirroring
+    u8 NameTableMap[4][4] = {
+        {0, 0, 1, 1},
+        {0, 1, 0, 1},
+        {0, 0, 0, 0},
+        {1, 1, 1, 1},
+    };
+    for (u32 Table = 0; Table < 4; Table++) {
+        Bus->NameTables[Table] = Bus->Ppu->NameTable[NameTableMap[Mapper->Mirroring][Table]];
+    }
+
+    Bus->ScanlineHandler = (Rom->MapperId == MapperMMC3) ? Mmc3Scanline : 0;
+}
+
+internal void
+Mmc1Write(bus* Bus, u16 Address, u8 Value) {
+    mapper* Mapper = Bus->Mapper;
+    // NOTE: A write on the cycle right after the last one is ignored, so the
+    //       second write of a read-modify-write (INC $8000 to reset) is lost
+    u64 Clock = Bus->Scheduler.MasterClock;
+    if (Mapper->ShiftClock && Clock - Mapper->ShiftClock <= CpuClockDivider) {
+        return;
+    }
+    Mapper->ShiftClock = Clock;
+
+    if (Value & Mmc1ShiftReset) {
+        Mapper->Shift = 0;
+        Mapper->ShiftCount = 0;
+        Mapper->Registers[0] |= Mmc1PrgModeMask;
+        return;
+    }
+
+    // NOTE: Five writes of bit 0, the fifth one's address picks the register
+    Mapper->Shift |= (Value & 1) << Mapper->ShiftCount;
+    Mapper->ShiftCount++;
+    if (Mapper->ShiftCount == 5) {
+        u32 Register = (Address >> 13) & 0b11;
+        Mapper->Registers[Register] = Mapper->Shift;
+        Mapper->Shift = 0;
+        Mapper->ShiftCount = 0;
+        if (Register == 0) {
+            mirroring Mirrorings[4] = {SingleScreenLow, SingleScreenHigh, Vertical, Horizontal};
+            Mapper->Mirroring = Mirrorings[Mapper->Registers[0] & Mmc1MirroringMask];
+        }
+    }
+}
+
+internal void
+Mmc3Write(bus* Bus, u16 Address, u8 Value) {
+    mapper* Mapper = Bus->Mapper;
+    // NOTE: Even/odd registers mirrored across each 8KB range
+    switch (Address & 0xE001) {
+        case 0x8000: Mapper->BankSelect = Value; break;
+        case 0x8001: Mapper->Registers[Mapper->BankSelect & Mmc3RegisterMask] = Value; break;
+        case 0xA000: {
+            if (!Bus->Rom->IgnoreMirroring) {
+                Mapper->Mirroring = (Value & 1) ? Horizontal : Vertical;
+            }
+        } break;
+        case 0xA001: {
+            // NOTE: PRG-RAM protect, ignored like most emulators do
+        } break;
+        case 0xC000: Mapper->IrqLatch = Value; break;
+        case 0xC001: {
+            Mapper->IrqCounter = 0;
+            Mapper->IrqReload = 1;
+        } break;
+        case 0xE000: {
+            Mapper->IrqEnabled = 0;
+            Mapper->IrqLine = 0;
+        } break;
+        case 0xE001: Mapper->IrqEnabled = 1; break;
+    }
+
+    if (Address >= 0xC000) {
+        MapperScheduleIrq(Bus);
+    }
+}
+
+// NOTE: Bus write handler for $8000-$FFFF
+internal void
+MapperWrite(bus* Bus, u16 Address, u8 Value) {
+    // NOTE: Pixels so far are drawn with the old banks and mirroring
+    PpuCatchUpToCpu(Bus);
+    PpuFlushScanline(Bus);
+
+    mapper* Mapper = Bus->Mapper;
+    switch (Bus->Rom->MapperId) {
+        case MapperMMC1: Mmc1Write(Bus, Address, Value); break;
+        case MapperUxROM:
+        case MapperCNROM: Mapper->Registers[0] = Value; break;
+        case MapperMMC3: Mmc3Write(Bus, Address, Value); break;
+        case MapperAxROM: {
+            Mapper->Registers[0] = Value;
+            Mapper->Mirroring = (Value & AxRomNametable) ? SingleScreenHigh : SingleScreenLow;
+        } break;
+        default: {
+            MemoryAccessTrap(Address, Value, "Unexpected writing");
+        } break;
+    }
+
+    MapperMapMemory(Bus);
+}
+
+#endif
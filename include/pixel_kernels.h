@@ -0,0 +1,289 @@
+#ifndef _EMU_PIXEL_KERNELS_H
+#define _EMU_PIXEL_KERNELS_H
+
+#include "base.h"
+
+/*
+
+    Hot pixel loops of the PPU with SIMD variants, picked by PixelKernelsInit
+    from what the host CPU supports. Every kernel has a scalar version that
+    is used before init, on non-x86 hosts and as the reference.
+
+    Variant tables (here, crc32.h and gfx.h) list the CPU features each
+    variant needs and are ordered from reference to preferred, so
+    SelectKernelVariant picks the last one the CPU has all features for.
+    Features are detected once, on first use.
+
+    DecodeTile:    16 bytes of CHR (8 low plane rows, 8 high plane rows) to
+                   64 palette indices (0-3), one byte per pixel.
+    ExpandIndices: Count indices (0-31) to u32 colours through a 32 entry
+                   colour table.
+
+*/
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXEL_KERNELS_X86 1
+#else
+#define PIXEL_KERNELS_X86 0
+#endif
+
+#if PIXEL_KERNELS_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define KernelTarget(Features)
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define KernelTarget(Features) __attribute__((target(Features)))
+#endif
+#endif
+
+typedef void tile_decode_kernel(u8* Dest, u8* Planes);
+typedef void index_expand_kernel(u32* Dest, u8* Indices, u32* Colors, i32 Count);
+
+// NOTE: CPU features a variant needs
+#define CpuSse2   (1 << 0)
+#define CpuSsse3  (1 << 1)
+#define CpuPclmul (1 << 2)
+#define CpuAvx2   (1 << 3)
+
+typedef struct tile_decode_variant {
+    char* Name;
+    tile_decode_kernel* Kernel;
+    u32 Features;
+} tile_decode_variant;
+
+typedef struct index_expand_variant {
+    char* Name;
+    index_expand_kernel* Kernel;
+    u32 Features;
+} index_expand_variant;
+
+internal void
+DecodeTileScalar(u8* Dest, u8* Planes) {
+    for (i32 Y = 0; Y < 8; Y++) {
+        u8 PlaneLow = Planes[Y];
+        u8 PlaneHigh = Planes[Y + 8];
+        for (i32 Shift = 7; Shift >= 0; Shift--) {
+            *Dest++ = ((PlaneLow >> Shift) & 0b01) | (((PlaneHigh >> Shift) << 1) & 0b10);
+        }
+    }
+}
+
+internal void
+ExpandIndicesScalar(u32* Dest, u8* Indices, u32* Colors, i32 Count) {
+    for (i32 PixelIndex = 0; PixelIndex < Count; PixelIndex++) {
+        Dest[PixelIndex] = Colors[Indices[PixelIndex]];
+    }
+}
+
+#if PIXEL_KERNELS_X86
+
+KernelTarget("sse2") internal void
+DecodeTileSse2(u8* Dest, u8* Planes) {
+    // NOTE: Every plane byte is repeated 8 times, then each copy is tested
+    //       against its own bit, two rows per 16 byte register
+    __m128i BitMask = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                   1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i One = _mm_set1_epi8(1);
+    __m128i Two = _mm_set1_epi8(2);
+
+    __m128i Low = _mm_loadl_epi64((__m128i*)Planes);
+    __m128i High = _mm_loadl_epi64((__m128i*)(Planes + 8));
+    Low = _mm_unpacklo_epi8(Low, Low);
+    High = _mm_unpacklo_epi8(High, High);
+
+    __m128i LowQuads[2] = {_mm_unpacklo_epi16(Low, Low), _mm_unpackhi_epi16(Low, Low)};
+    __m128i HighQuads[2] = {_mm_unpacklo_epi16(High, High), _mm_unpackhi_epi16(High, High)};
+
+    for (i32 Half = 0; Half < 2; Half++) {
+        __m128i LowRows[2] = {
+            _mm_unpacklo_epi32(LowQuads[Half], LowQuads[Half]),
+            _mm_unpackhi_epi32(LowQuads[Half], LowQuads[Half]),
+        };
+        __m128i HighRows[2] = {
+            _mm_unpacklo_epi32(HighQuads[Half], HighQuads[Half]),
+            _mm_unpackhi_epi32(HighQuads[Half], HighQuads[Half]),
+        };
+        for (i32 Pair = 0; Pair < 2; Pair++) {
+            __m128i PixelLow = _mm_cmpeq_epi8(_mm_and_si128(LowRows[Pair], BitMask), BitMask);
+            __m128i PixelHigh = _mm_cmpeq_epi8(_mm_and_si128(HighRows[Pair], BitMask), BitMask);
+            __m128i Pixels = _mm_or_si128(_mm_and_si128(PixelLow, One), _mm_and_si128(PixelHigh, Two));
+            _mm_storeu_si128((__m128i*)(Dest + (((Half * 2) + Pair) * 16)), Pixels);
+        }
+    }
+}
+
+KernelTarget("ssse3") internal void
+ExpandIndicesSsse3(u32* Dest, u8* Indices, u32* Colors, i32 Count) {
+    // NOTE: Colours are split into byte planes, 16 entries per register,
+    //       PSHUFB looks up 16 pixels of one byte plane at a time
+    __m128i GroupBytes = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    __m128i PlanesLow[4];
+    __m128i PlanesHigh[4];
+    for (i32 Half = 0; Half < 2; Half++) {
+        __m128i Quads[4];
+        for (i32 Quad = 0; Quad < 4; Quad++) {
+            __m128i Entries = _mm_loadu_si128((__m128i*)(Colors + (Half * 16) + (Quad * 4)));
+            Quads[Quad] = _mm_shuffle_epi8(Entries, GroupBytes);
+        }
+        // NOTE: 4x4 transpose of the dwords, dword N of quad Q is byte N of entries 4Q-4Q+3
+        __m128i Quads01Low = _mm_unpacklo_epi32(Quads[0], Quads[1]);
+        __m128i Quads01High = _mm_unpackhi_epi32(Quads[0], Quads[1]);
+        __m128i Quads23Low = _mm_unpacklo_epi32(Quads[2], Quads[3]);
+        __m128i Quads23High = _mm_unpackhi_epi32(Quads[2], Quads[3]);
+        __m128i* Planes = Half ? PlanesHigh : PlanesLow;
+        Planes[0] = _mm_unpacklo_epi64(Quads01Low, Quads23Low);
+        Planes[1] = _mm_unpackhi_epi64(Quads01Low, Quads23Low);
+        Planes[2] = _mm_unpacklo_epi64(Quads01High, Quads23High);
+        Planes[3] = _mm_unpackhi_epi64(Quads01High, Quads23High);
+    }
+    __m128i Fifteen = _mm_set1_epi8(15);
+
+    i32 PixelIndex = 0;
+    for (; PixelIndex + 16 <= Count; PixelIndex += 16) {
+        __m128i Index = _mm_loadu_si128((__m128i*)(Indices + PixelIndex));
+        __m128i UseHigh = _mm_cmpgt_epi8(Index, Fifteen);
+
+        __m128i Bytes[4];
+        for (i32 Byte = 0; Byte < 4; Byte++) {
+            __m128i Low = _mm_shuffle_epi8(PlanesLow[Byte], Index);
+            __m128i High = _mm_shuffle_epi8(PlanesHigh[Byte], Index);
+            Bytes[Byte] = _mm_or_si128(_mm_and_si128(UseHigh, High), _mm_andnot_si128(UseHigh, Low));
+        }
+
+        __m128i Bytes01Low = _mm_unpacklo_epi8(Bytes[0], Bytes[1]);
+        __m128i Bytes01High = _mm_unpackhi_epi8(Bytes[0], Bytes[1]);
+        __m128i Bytes23Low = _mm_unpacklo_epi8(Bytes[2], Bytes[3]);
+        __m128i Bytes23High = _mm_unpackhi_epi8(Bytes[2], Bytes[3]);
+
+        __m128i* Pixels = (__m128i*)(Dest + PixelIndex);
+        _mm_storeu_si128(Pixels + 0, _mm_unpacklo_epi16(Bytes01Low, Bytes23Low));
+        _mm_storeu_si128(Pixels + 1, _mm_unpackhi_epi16(Bytes01Low, Bytes23Low));
+        _mm_storeu_si128(Pixels + 2, _mm_unpacklo_epi16(Bytes01High, Bytes23High));
+        _mm_storeu_si128(Pixels + 3, _mm_unpackhi_epi16(Bytes01High, Bytes23High));
+    }
+
+    ExpandIndicesScalar(Dest + PixelIndex, Indices + PixelIndex, Colors, Count - PixelIndex);
+}
+
+KernelTarget("avx2") internal void
+ExpandIndicesAvx2(u32* Dest, u8* Indices, u32* Colors, i32 Count) {
+    i32 PixelIndex = 0;
+    for (; PixelIndex + 8 <= Count; PixelIndex += 8) {
+        __m256i Index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*)(Indices + PixelIndex)));
+        __m256i Pixels = _mm256_i32gather_epi32((int*)Colors, Index, 4);
+        _mm256_storeu_si256((__m256i*)(Dest + PixelIndex), Pixels);
+    }
+
+    ExpandIndicesScalar(Dest + PixelIndex, Indices + PixelIndex, Colors, Count - PixelIndex);
+}
+
+internal void
+PixelKernelsCpuid(u32 Leaf, u32 SubLeaf, u32* Registers) {
+#if defined(_MSC_VER)
+    __cpuidex((int*)Registers, Leaf, SubLeaf);
+#else
+    __cpuid_count(Leaf, SubLeaf, Registers[0], Registers[1], Registers[2], Registers[3]);
+#endif
+}
+
+internal u64
+PixelKernelsXgetbv(void) {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    u32 Low;
+    u32 High;
+    __asm__ volatile("xgetbv" : "=a"(Low), "=d"(High) : "c"(0));
+    return ((u64)High << 32) | Low;
+#endif
+}
+
+#endif
+
+global_variable u32 CpuFeatures;
+global_variable bool32 CpuFeaturesReady;
+
+internal u32
+CpuFeaturesDetect(void) {
+    if (CpuFeaturesReady) {
+        return CpuFeatures;
+    }
+    CpuFeaturesReady = 1;
+#if PIXEL_KERNELS_X86
+    u32 Registers[4];
+    PixelKernelsCpuid(0, 0, Registers);
+    u32 MaxLeaf = Registers[0];
+
+    PixelKernelsCpuid(1, 0, Registers);
+    CpuFeatures |= ((Registers[3] >> 26) & 1) ? CpuSse2 : 0;
+    CpuFeatures |= ((Registers[2] >> 9) & 1) ? CpuSsse3 : 0;
+    CpuFeatures |= ((Registers[2] >> 1) & 1) ? CpuPclmul : 0;
+    bool32 OsSavesYmm = 0;
+    if ((Registers[2] >> 27) & 1) {
+        OsSavesYmm = (PixelKernelsXgetbv() & 0b110) == 0b110;
+    }
+
+    if (MaxLeaf >= 7) {
+        PixelKernelsCpuid(7, 0, Registers);
+        CpuFeatures |= (OsSavesYmm && ((Registers[1] >> 5) & 1)) ? CpuAvx2 : 0;
+    }
+#endif
+    return CpuFeatures;
+}
+
+internal bool32
+KernelVariantSupported(u32 Features) {
+    return (CpuFeaturesDetect() & Features) == Features;
+}
+
+// NOTE: Index of the last supported variant. Features points into the first
+//       entry of a variant table, Stride is the entry size.
+internal u32
+KernelVariantIndex(u32* Features, u32 Count, size_t Stride) {
+    u32 Result = 0;
+    for (u32 VariantIndex = 0; VariantIndex < Count; VariantIndex++) {
+        u32* VariantFeatures = (u32*)((u8*)Features + (VariantIndex * Stride));
+        if (KernelVariantSupported(*VariantFeatures)) {
+            Result = VariantIndex;
+        }
+    }
+    return Result;
+}
+
+#define SelectKernelVariant(Variants) \
+    ((Variants) + KernelVariantIndex(&(Variants)[0].Features, ArrayCount(Variants), sizeof((Variants)[0])))
+
+global_variable tile_decode_variant TileDecodeVariants[] = {
+    {"scalar", DecodeTileScalar, 0},
+#if PIXEL_KERNELS_X86
+    {"sse2", DecodeTileSse2, CpuSse2},
+#endif
+};
+
+global_variable index_expand_variant IndexExpandVariants[] = {
+    {"scalar", ExpandIndicesScalar, 0},
+#if PIXEL_KERNELS_X86
+    {"ssse3", ExpandIndicesSsse3, CpuSsse3},
+    {"avx2", ExpandIndicesAvx2, CpuAvx2},
+#endif
+};
+
+global_variable tile_decode_kernel* DecodeTile = DecodeTileScalar;
+global_variable index_expand_kernel* ExpandIndices = ExpandIndicesScalar;
+global_variable char* DecodeTileName = "scalar";
+global_variable char* ExpandIndicesName = "scalar";
+
+internal void
+PixelKernelsInit(void) {
+    tile_decode_variant* TileDecode = SelectKernelVariant(TileDecodeVariants);
+    DecodeTile = TileDecode->Kernel;
+    DecodeTileName = TileDecode->Name;
+
+    index_expand_variant* IndexExpand = SelectKernelVariant(IndexExpandVariants);
+    ExpandIndices = IndexExpand->Kernel;
+    ExpandIndicesName = IndexExpand->Name;
+}
+
+#endif
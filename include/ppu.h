@@ -5,8 +5,10 @@
 #include "constants.h"
 #include "emu_types.h"
 #include "bus.h"
+#include "profiler.h"
+#include "pixel_kernels.h"
 
-#include <stdlib.h>
+#include <string.h>
 
 #define NesScreenWidth (256)
 #define NesScreenHeight (240)
@@ -20,6 +22,22 @@
 #define IncrementModeMask        (0b00000100)
 #define NametableSelectMask      (0b00000011)
 
+// NOTE: PPUMASK bits
+#define ShowSpritesMask          (0b00010000)
+#define ShowBackgroundMask       (0b00001000)
+#define ShowSpritesLeftMask      (0b00000100)
+#define ShowBackgroundLeftMask   (0b00000010)
+#define GreyscaleMask            (0b00000001)
+#define RenderingEnabledMask     (ShowSpritesMask | ShowBackgroundMask)
+
+// NOTE: Address (v/t) fields
+#define CoarseXMask              (0b000000000011111)
+#define CoarseYMask              (0b000001111100000)
+#define HorizontalNametableMask  (0b000010000000000)
+#define VerticalNametableMask    (0b000100000000000)
+#define FineYMask                (0b111000000000000)
+#define VramAddressMask          (0x3FFF)
+
 // NOTE: PPUSTATUS bits
 #define VBlankOffset         (7)
 // #define VBlank               (0b10000000)
@@ -28,6 +46,13 @@
 // #define SpriteOverflow       (0b00100000)
 #define SpriteOverflowOffest (5)
 
+#define PatternSizeInBytes       (16)
+#define PatternPlaneSizeInBytes  (8)
+#define PatternSizeInPixels      (8)
+#define PatternsPerColum         (16)
+#define LeftPatternTableAddress  (0x0000)
+#define RightPatternTableAddress (0x1000)
+
 internal u8
 PpuPackStatus(ppu* Ppu) {
     u8 Result = (Ppu->Status.VerticalBlank << VBlankOffset)
@@ -36,15 +61,6 @@ PpuPackStatus(ppu* Ppu) {
     return Result;
 }
 
-internal ppu_pixel
-PpuGetCurrentPixel(ppu* Ppu) {
-    ppu_pixel Result;
-    Result.Color = 0xFF000000 | (rand() | ((u32)rand() << 16));
-    Result.X = Ppu->Dot - 1;
-    Result.Y = Ppu->Scanline;
-    return Result;
-}
-
 internal ppu
 PpuInit(void) {
     ppu Result = {0};
@@ -54,36 +70,109 @@ PpuInit(void) {
 #define PpuDotPerScanline      (341)
 #define PpuScanlineCount       (261)
 #define PpuVblankStartScanline (241)
+#define PpuLastScanline        (PpuScanlineCount - 1)
+#define PpuFrameDotCount       (PpuDotPerScanline * (PpuScanlineCount + 1))
+// NOTE: Dots 1-256 output pixels, the scanline is finished after dot 256
+#define PpuVisibleDotEnd       (NesScreenWidth + 1)
+// NOTE: Sprite pattern fetches of a rendered line start after this dot, the
+//       first A12 rise with sprites at $1000 (scanline counting mappers)
+#define PpuScanlineCounterDot  (260)
+
+// NOTE: 2C02 palette, stored as xbgr like the rest of the pixel buffers
+#define NesColor(R, G, B) (0xFF000000 | ((B) << 16) | ((G) << 8) | (R))
+
+global_variable u32 NesColors[64] = {
+    NesColor( 84,  84,  84), NesColor(  0,  30, 116), NesColor(  8,  16, 144), NesColor( 48,   0, 136),
+    NesColor( 68,   0, 100), NesColor( 92,   0,  48), NesColor( 84,   4,   0), NesColor( 60,  24,   0),
+    NesColor( 32,  42,   0), NesColor(  8,  58,   0), NesColor(  0,  64,   0), NesColor(  0,  60,   0),
+    NesColor(  0,  50,  60), NesColor(  0,   0,   0), NesColor(  0,   0,   0), NesColor(  0,   0,   0),
+    NesColor(152, 150, 152), NesColor(  8,  76, 196), NesColor( 48,  50, 236), NesColor( 92,  30, 228),
+    NesColor(136,  20, 176), NesColor(160,  20, 100), NesColor(152,  34,  32), NesColor(120,  60,   0),
+    NesColor( 84,  90,   0), NesColor( 40, 114,   0), NesColor(  8, 124,   0), NesColor(  0, 118,  40),
+    NesColor(  0, 102, 120), NesColor(  0,   0,   0), NesColor(  0,   0,   0), NesColor(  0,   0,   0),
+    NesColor(236, 238, 236), NesColor( 76, 154, 236), NesColor(120, 124, 236), NesColor(176,  98, 236),
+    NesColor(228,  84, 236), NesColor(236,  88, 180), NesColor(236, 106, 100), NesColor(212, 136,  32),
+    NesColor(160, 170,   0), NesColor(116, 196,   0), NesColor( 76, 208,  32), NesColor( 56, 204, 108),
+    NesColor( 56, 180, 204), NesColor( 60,  60,  60), NesColor(  0,   0,   0), NesColor(  0,   0,   0),
+    NesColor(236, 238, 236), NesColor(168, 204, 236), NesColor(188, 188, 236), NesColor(212, 178, 236),
+    NesColor(236, 174, 236), NesColor(236, 174, 212), NesColor(236, 180, 176), NesColor(228, 196, 144),
+    NesColor(204, 210, 120), NesColor(180, 222, 120), NesColor(168, 226, 144), NesColor(152, 226, 180),
+    NesColor(160, 214, 228), NesColor(160, 162, 160), NesColor(  0,   0,   0), NesColor(  0,   0,   0),
+};
 
 internal void
-PpuTick(ppu* Ppu) {
-    if (Ppu->Scanline == -1 && Ppu->Dot == 0) {
-        Ppu->Status.VerticalBlank = 0;
+PpuUpdateNmiOutput(bus* Bus) {
+    ppu* Ppu = Bus->Ppu;
+    bool32 NmiOutput = Ppu->Status.VerticalBlank && (Ppu->Control & NmiEnableMask);
+    if (NmiOutput && !Ppu->NmiOutput) {
+        Ppu->NmiPending = 1;
+        Ppu->NmiDot = Bus->Scheduler.PpuClock;
+    }
+    Ppu->NmiOutput = NmiOutput;
+}
+
+internal u64
+PpuTicksUntil(ppu* Ppu, i32 Scanline, i32 Dot) {
+    // NOTE: Position -1:0 is the start of a frame, counting goes up to 260:340
+    i32 Current = ((Ppu->Scanline + 1) * PpuDotPerScanline) + Ppu->Dot;
+    i32 Target = ((Scanline + 1) * PpuDotPerScanline) + Dot;
+    i32 Result = Target - Current;
+    if (Result < 0) {
+        Result += PpuFrameDotCount;
     }
+    return (u64)Result;
+}
 
-    if (Ppu->Scanline == PpuVblankStartScanline && Ppu->Dot == 0) {
-        Ppu->Status.VerticalBlank = 1;
+internal u8*
+PpuNameTable(bus* Bus, u16 Address) {
+    // NOTE: $2000-$2FFF (mirrored up to $3EFF), 4 logical tables on 2 physical
+    //       ones, the mapper decides which
+    return Bus->NameTables[(Address >> 10) & 0b11];
+}
+
+internal u8*
+PpuPaletteEntry(ppu* Ppu, u16 Address) {
+    // NOTE: $3F10/$3F14/$3F18/$3F1C mirror the backdrop entries of the background
+    u16 Index = Address & 0x1F;
+    if ((Index & 0x13) == 0x10) {
+        Index &= ~0x10;
     }
+    return Ppu->Palette + Index;
+}
 
-	Ppu->Dot++;
-	if (Ppu->Dot >= PpuDotPerScanline)
-	{
-		Ppu->Dot = 0;
-		Ppu->Scanline++;
-		if (Ppu->Scanline >= PpuScanlineCount)
-		{
-			Ppu->Scanline = -1;
-			Ppu->FrameComplete = 1;
-		}
-	}
+internal void
+ChrCacheInit(chr_cache* Cache) {
+    for (i32 TileIndex = 0; TileIndex < ChrTileCount; TileIndex++) {
+        Cache->Dirty[TileIndex] = 1;
+        Cache->Version[TileIndex] = 0;
+    }
+    Cache->Generation = 0;
+}
+
+// NOTE: Call on CHR-RAM writes and CHR bank switches, Address and Size are
+//       in PPU pattern table space ($0000-$1FFF)
+internal void
+ChrCacheInvalidate(chr_cache* Cache, u16 Address, u16 Size) {
+    i32 FirstTile = Address / PatternSizeInBytes;
+    i32 EndTile = (Address + Size + PatternSizeInBytes - 1) / PatternSizeInBytes;
+    if (EndTile > ChrTileCount) {
+        EndTile = ChrTileCount;
+    }
+    for (i32 TileIndex = FirstTile; TileIndex < EndTile; TileIndex++) {
+        Cache->Dirty[TileIndex] = 1;
+        Cache->Version[TileIndex]++;
+    }
+    Cache->Generation++;
 }
 
 internal u8
 PpuRead(bus* Bus, u16 Address) {
     if (Address >= 0x0000 && Address <= 0x1FFF) {
-        Assert(Bus->Rom->MapperId == MapperNROM);
-        //TODO: Mapper should work here! For now: NROM only
-        return Bus->Rom->Chr[Address];
+        return Bus->ChrBanks[Address >> 10][Address & 0x03FF];
+    } else if (Address >= 0x2000 && Address <= 0x3EFF) {
+        return PpuNameTable(Bus, Address)[Address & 0x03FF];
+    } else if (Address >= 0x3F00 && Address <= 0x3FFF) {
+        return *PpuPaletteEntry(Bus->Ppu, Address);
     }
     MemoryAccessTrap(Address, 0x00, "Let's not read here, yet")
     return 0x00;
@@ -91,92 +180,233 @@ PpuRead(bus* Bus, u16 Address) {
 
 internal void
 PpuWrite(bus* Bus, u16 Address, u8 Value) {
-    Assert(Bus->Rom->MapperId == MapperNROM);
-    Assert(Bus->Rom->Mirroring == Horizontal);
-    //TODO: Mapper should work here! For now: NROM only
-
-    if (Address >= 0x2000 && Address <= 0x3EFF) {
-        u16 NameTableAddress = Address & 0b0000111111111111;
-        if (Bus->Rom->Mirroring == Vertical) {
-            if (NameTableAddress >= 0x0000 && NameTableAddress <= 0x03FF) {
-                Bus->Ppu->NameTable[0][NameTableAddress & 0b0000001111111111] = Value;
-            } else if (NameTableAddress >= 0x0400 && NameTableAddress <= 0x07FF) {
-                Bus->Ppu->NameTable[1][NameTableAddress & 0b0000001111111111] = Value;
-            } else if (NameTableAddress >= 0x0800 && NameTableAddress <= 0x0BFF) {
-                Bus->Ppu->NameTable[0][NameTableAddress & 0b0000001111111111] = Value;
-            } else if (NameTableAddress >= 0x0C00 && NameTableAddress <= 0x0FFF) {
-                Bus->Ppu->NameTable[1][NameTableAddress & 0b0000001111111111] = Value;
-            }
-        } else if (Bus->Rom->Mirroring == Horizontal) {
-            if (NameTableAddress >= 0x0000 && NameTableAddress <= 0x03FF) {
-                Bus->Ppu->NameTable[0][NameTableAddress & 0b0000001111111111] = Value;
-            } else if (NameTableAddress >= 0x0400 && NameTableAddress <= 0x07FF) {
-                Bus->Ppu->NameTable[0][NameTableAddress & 0b0000001111111111] = Value;
-            } else if (NameTableAddress >= 0x0800 && NameTableAddress <= 0x0BFF) {
-                Bus->Ppu->NameTable[1][NameTableAddress & 0b0000001111111111] = Value;
-            } else if (NameTableAddress >= 0x0C00 && NameTableAddress <= 0x0FFF) {
-                Bus->Ppu->NameTable[1][NameTableAddress & 0b0000001111111111] = Value;
-            }
+    if (Address >= 0x0000 && Address <= 0x1FFF) {
+        if (!Bus->Rom->HasChrRam) {
+            MemoryAccessTrap(Address, Value, "Writing to CHR-ROM");
         }
+        Bus->ChrBanks[Address >> 10][Address & 0x03FF] = Value;
+        ChrCacheInvalidate(Bus->ChrCache, Address, 1);
+    } else if (Address >= 0x2000 && Address <= 0x3EFF) {
+        PpuNameTable(Bus, Address)[Address & 0x03FF] = Value;
     } else if (Address >= 0x3F00 && Address <= 0x3FFF) {
-        //TODO: Palletes
-        //MemoryAccessTrap(Address, Value, "Palletes needed!");
+        *PpuPaletteEntry(Bus->Ppu, Address) = Value & 0x3F;
     } else {
         MemoryAccessTrap(Address, Value, "No writing to PPU, yet");
     }
 }
 
-#define PatternSizeInBytes       (16)
-#define PatternPlaneSizeInBytes  (8)
-#define PatternSizeInPixels      (8)
-#define PatternsPerColum         (16)
-#define LeftPatternTableAddress  (0x0000)
-#define RightPatternTableAddress (0x1000)
+// NOTE: Tile 0-255 is the left pattern table, 256-511 the right one
+internal u8*
+ChrCacheTile(bus* Bus, i32 TileIndex) {
+    chr_cache* Cache = Bus->ChrCache;
+    if (Cache->Dirty[TileIndex]) {
+        u8 Planes[PatternSizeInBytes];
+        u16 PatternAddress = (u16)(TileIndex * PatternSizeInBytes);
+        for (i32 ByteIndex = 0; ByteIndex < PatternSizeInBytes; ByteIndex++) {
+            Planes[ByteIndex] = PpuRead(Bus, PatternAddress + ByteIndex);
+        }
+        DecodeTile(Cache->Pixels[TileIndex], Planes);
+        Cache->Dirty[TileIndex] = 0;
+    }
+    return Cache->Pixels[TileIndex];
+}
+
+// NOTE: Draws background pixels [LineX, EndX) of the current scanline. Tile
+//       rows are copied into a line of palette indices (palette * 4 + pixel)
+//       which is then expanded to colours in one go. Scroll comes from
+//       Address/FineX as of the last flush.
+internal void
+PpuRenderBackground(bus* Bus, i32 EndX) {
+    ppu* Ppu = Bus->Ppu;
+    pixel_buffer* Screen = Bus->Screen;
+    if (EndX > NesScreenWidth) {
+        EndX = NesScreenWidth;
+    }
+    if (Ppu->Scanline < 0 || Ppu->Scanline >= NesScreenHeight || Ppu->LineX >= EndX) {
+        return;
+    }
+    if (!Screen) {
+        // NOTE: Undrawn frames (run-ahead) leave the same PPU state as drawn ones
+        Ppu->LineX = EndX;
+        return;
+    }
+
+    // NOTE: A tile row is always copied whole, the first one may start up
+    //       to 7 pixels before LineX and the last one may end past EndX
+    u8 LineBuffer[PatternSizeInPixels + NesScreenWidth + PatternSizeInPixels];
+    u8* Indices = LineBuffer + PatternSizeInPixels;
+    i32 X = Ppu->LineX;
 
-internal u32
-PpuGetTilePixel(bus* Bus,
-                pattern_table_half Half,
-                i32 Row, i32 Column,
-                i32 OffsetX, i32 OffsetY) {
+    if (Ppu->Mask & ShowBackgroundMask) {
+        u16 Address = Ppu->Address;
+        u16 FineY = (Address & FineYMask) >> 12;
+        u16 CoarseY = (Address & CoarseYMask) >> 5;
+        i32 TileBase = (Ppu->Control & BackgroundTileSelectMask) ? 256 : 0;
+        i32 Offset = Ppu->FineX + (X - Ppu->LineOriginX);
 
-    u16 PatternAddress;
-    if (Half == Left) {
-        PatternAddress = LeftPatternTableAddress;
+        while (X < EndX) {
+            u16 CoarseX = (Address & CoarseXMask) + (Offset >> 3);
+            u16 NameTableAddress = Address;
+            if (CoarseX & 0x20) {
+                NameTableAddress ^= HorizontalNametableMask;
+            }
+            CoarseX &= 0x1F;
+
+            u8* NameTable = PpuNameTable(Bus, NameTableAddress);
+            u8 TileIndex = NameTable[(CoarseY * NametableTileTilePerRowCount) + CoarseX];
+            u8 Attribute = NameTable[0x03C0 + ((CoarseY >> 2) * 8) + (CoarseX >> 2)];
+            u8 PaletteSelect = (Attribute >> (((CoarseY & 0b10) << 1) | (CoarseX & 0b10))) & 0b11;
+
+            u64 TileRow;
+            memcpy(&TileRow, ChrCacheTile(Bus, TileBase + TileIndex) + (FineY * PatternSizeInPixels), sizeof(TileRow));
+            TileRow |= PaletteSelect * 0x0404040404040404ULL;
+
+            i32 PixelInTile = Offset & 0b111;
+            memcpy(Indices + X - PixelInTile, &TileRow, sizeof(TileRow));
+
+            X += PatternSizeInPixels - PixelInTile;
+            Offset += PatternSizeInPixels - PixelInTile;
+        }
+
+        if (!(Ppu->Mask & ShowBackgroundLeftMask)) {
+            for (X = Ppu->LineX; X < EndX && X < PatternSizeInPixels; X++) {
+                Indices[X] = 0;
+            }
+        }
+    } else {
+        memset(Indices + X, 0, EndX - X);
+    }
+
+    // NOTE: Pixel value 0 of every background palette shows the backdrop
+    u32 Colors[32];
+    for (i32 ColorIndex = 0; ColorIndex < 32; ColorIndex++) {
+        Colors[ColorIndex] = NesColors[Ppu->Palette[(ColorIndex & 0b11) ? ColorIndex : 0]];
+    }
+
+    u32* Row = Screen->Memory + (Ppu->Scanline * Screen->Width);
+    ExpandIndices(Row + Ppu->LineX, Indices + Ppu->LineX, Colors, EndX - Ppu->LineX);
+
+    Ppu->LineX = EndX;
+}
+
+internal void
+PpuFlushScanline(bus* Bus) {
+    // NOTE: Draw what the PPU has output so far before a register write changes it
+    ppu* Ppu = Bus->Ppu;
+    if (Ppu->Dot > 0 && Ppu->Dot <= PpuVisibleDotEnd) {
+        PpuRenderBackground(Bus, Ppu->Dot - 1);
+    }
+}
+
+internal void
+PpuEndVisibleScanline(bus* Bus) {
+    ppu* Ppu = Bus->Ppu;
+    PpuRenderBackground(Bus, NesScreenWidth);
+
+    if (!(Ppu->Mask & RenderingEnabledMask)) {
+        return;
+    }
+
+    // NOTE: Dot 256 increments Y, dot 257 reloads horizontal scroll from t,
+    //       the pre-render line also reloads vertical scroll (dots 280-304)
+    u16 Address = Ppu->Address;
+    if ((Address & FineYMask) != FineYMask) {
+        Address += 0x1000;
     } else {
-        PatternAddress = RightPatternTableAddress;
+        Address &= ~FineYMask;
+        u16 CoarseY = (Address & CoarseYMask) >> 5;
+        if (CoarseY == NametableTileRowCount - 1) {
+            CoarseY = 0;
+            Address ^= VerticalNametableMask;
+        } else if (CoarseY == 31) {
+            CoarseY = 0;
+        } else {
+            CoarseY++;
+        }
+        Address = (Address & ~CoarseYMask) | (CoarseY << 5);
     }
 
-    PatternAddress += (PatternsPerColum * Row * PatternSizeInBytes) + (Column * PatternSizeInBytes);
+    u16 HorizontalBits = CoarseXMask | HorizontalNametableMask;
+    Address = (Address & ~HorizontalBits) | (Ppu->TempAddress & HorizontalBits);
+    if (Ppu->Scanline == -1) {
+        u16 VerticalBits = FineYMask | VerticalNametableMask | CoarseYMask;
+        Address = (Address & ~VerticalBits) | (Ppu->TempAddress & VerticalBits);
+    }
+    Ppu->Address = Address;
+}
 
-    u8 PatternPixelBitMask = 0b10000000 >> OffsetX;
+// NOTE: Runs the PPU until it has done TargetClock dots in total. Works
+//       a scanline segment at a time: dot 0 of -1 and 241 changes vblank,
+//       dot 256 finishes the background of scanlines -1 to 239.
+internal void
+PpuCatchUp(bus* Bus, u64 TargetClock) {
+    BeginTimedBlock(PpuCatchUp);
+    ppu* Ppu = Bus->Ppu;
+    scheduler* Scheduler = &Bus->Scheduler;
 
-    u8 PatternRows[2] = {
-        PpuRead(Bus, PatternAddress + OffsetY),
-        PpuRead(Bus, PatternAddress + OffsetY + PatternPlaneSizeInBytes),
-    };
+    while (Scheduler->PpuClock < TargetClock) {
+        u64 DotsLeft = TargetClock - Scheduler->PpuClock;
+        bool32 RenderLine = Ppu->Scanline < NesScreenHeight;
+        i32 DotCount = PpuDotPerScanline - Ppu->Dot;
+        if (RenderLine && Ppu->Dot < PpuVisibleDotEnd) {
+            DotCount = PpuVisibleDotEnd - Ppu->Dot;
+        }
+        // NOTE: Segments stop right after dot 260 for the mapper
+        bool32 ScanlineCounted = RenderLine && Bus->ScanlineHandler;
+        if (ScanlineCounted && Ppu->Dot <= PpuScanlineCounterDot &&
+            Ppu->Dot + DotCount > PpuScanlineCounterDot + 1) {
+            DotCount = PpuScanlineCounterDot + 1 - Ppu->Dot;
+        }
+        if (DotsLeft < (u64)DotCount) {
+            DotCount = (i32)DotsLeft;
+        }
 
-    PatternRows[0] = PatternRows[0] & PatternPixelBitMask;
-    PatternRows[1] = PatternRows[1] & PatternPixelBitMask;
+        if (Ppu->Dot == 0) {
+            Ppu->LineX = 0;
+            Ppu->LineOriginX = 0;
+            if (Ppu->Scanline == -1) {
+                Ppu->Status.VerticalBlank = 0;
+                PpuUpdateNmiOutput(Bus);
+            } else if (Ppu->Scanline == PpuVblankStartScanline) {
+                Ppu->Status.VerticalBlank = 1;
+                PpuUpdateNmiOutput(Bus);
+            }
+        }
 
-    PatternRows[0] = (PatternRows[0]) ? 0b00000001 : 0b00000000;
-    PatternRows[1] = (PatternRows[1]) ? 0b00000010 : 0b00000000;
+        Ppu->Dot += DotCount;
+        Scheduler->PpuClock += DotCount;
 
-    u8 PalleteIndex = PatternRows[0] | PatternRows[1];
-    Assert(PalleteIndex >= 0 && PalleteIndex <= 3);
+        if (ScanlineCounted && Ppu->Dot == PpuScanlineCounterDot + 1 &&
+            (Ppu->Mask & RenderingEnabledMask)) {
+            Bus->ScanlineHandler(Bus);
+        }
 
-    u32 PoorMansPallete[4] = {
-        0xFFCC0000,
-        0xFF33CC33,
-        0xFF7777CC,
-        0xFFEEEEEE,
-    };
+        if (RenderLine && Ppu->Dot == PpuVisibleDotEnd) {
+            PpuEndVisibleScanline(Bus);
+        }
 
-    return PoorMansPallete[PalleteIndex];
+        if (Ppu->Dot >= PpuDotPerScanline) {
+            Ppu->Dot = 0;
+            Ppu->Scanline++;
+            if (Ppu->Scanline >= PpuScanlineCount) {
+                Ppu->Scanline = -1;
+                Ppu->FrameComplete = 1;
+            }
+        }
+    }
+    EndTimedBlock(PpuCatchUp);
+}
+
+internal void
+PpuCatchUpToCpu(bus* Bus) {
+    // NOTE: The PPU dot of the current master tick happens before the CPU access
+    PpuCatchUp(Bus, Bus->Scheduler.MasterClock + 1);
 }
 
 internal u8
 PpuRegisterRead(bus* Bus, u16 Address) {
-    u16 PpuRegister = (Address - PpuRegisterAddressStart) % PpuRegisterCount;
+    PpuCatchUpToCpu(Bus);
+    u16 PpuRegister = Address & (PpuRegisterCount - 1);
     if (PpuRegister == PPUCTRL) {
         return Bus->Ppu->Control;
     } else if (PpuRegister == PPUMASK) {
@@ -192,7 +422,9 @@ PpuRegisterRead(bus* Bus, u16 Address) {
     } else if (PpuRegister == PPUADDR) {
         return 0x00;
     } else if (PpuRegister == PPUDATA) {
-        u8 Result = PpuRead(Bus, Bus->Ppu->Address);
+        // NOTE: Pixels already output use the address before the increment
+        PpuFlushScanline(Bus);
+        u8 Result = PpuRead(Bus, Bus->Ppu->Address & VramAddressMask);
         //TODO: Make increment a post-read operation
         u16 IncrementAmount = (Bus->Ppu->Control & IncrementModeMask) ? 32 : 1;
         Bus->Ppu->Address += IncrementAmount;
@@ -206,12 +438,18 @@ PpuRegisterRead(bus* Bus, u16 Address) {
 
 internal void
 PpuRegisterWrite(bus* Bus, u16 Address, u8 Value) {
-    u16 PpuRegister = (Address - PpuRegisterAddressStart) % PpuRegisterCount;
+    PpuCatchUpToCpu(Bus);
+    PpuFlushScanline(Bus);
+    ppu* Ppu = Bus->Ppu;
+    u16 PpuRegister = Address & (PpuRegisterCount - 1);
     // PPU Registers
     if (PpuRegister == PPUCTRL) {
-        Bus->Ppu->Control = Value;
+        Ppu->Control = Value;
+        Ppu->TempAddress = (Ppu->TempAddress & ~(HorizontalNametableMask | VerticalNametableMask))
+                         | ((Value & NametableSelectMask) << 10);
+        PpuUpdateNmiOutput(Bus);
     } else if (PpuRegister == PPUMASK) {
-        Bus->Ppu->Mask = Value;
+        Ppu->Mask = Value;
     } else if (PpuRegister == PPUSTATUS) {
         // TODO: Check if writing to PPUSTATUS is ever legit
     } else if (PpuRegister == OAMADDR) {
@@ -219,25 +457,33 @@ PpuRegisterWrite(bus* Bus, u16 Address, u8 Value) {
     } else if (PpuRegister == OAMDATA) {
         //MemoryAccessTrap(Address, Value, "OAMDATA");
     } else if (PpuRegister == PPUSCROLL) {
-        //TODO: Figure out scrolling
-        if (Bus->Ppu->AddressLatch) {
-            Bus->Ppu->AddressLatch = 0;
+        if (Ppu->AddressLatch) {
+            Ppu->TempAddress = (Ppu->TempAddress & ~(FineYMask | CoarseYMask))
+                             | ((Value & 0b111) << 12)
+                             | ((Value >> 3) << 5);
+            Ppu->AddressLatch = 0;
         } else {
-            Bus->Ppu->AddressLatch = 1;
+            Ppu->TempAddress = (Ppu->TempAddress & ~CoarseXMask) | (Value >> 3);
+            Ppu->FineX = Value & 0b111;
+            Ppu->AddressLatch = 1;
         }
     } else if (PpuRegister == PPUADDR) {
-        if (Bus->Ppu->AddressLatch) {
-            Bus->Ppu->TempAddress = (Bus->Ppu->TempAddress & 0xFF00) | (Value << 0);
-            Bus->Ppu->AddressLatch = 0;
+        if (Ppu->AddressLatch) {
+            Ppu->TempAddress = (Ppu->TempAddress & 0xFF00) | (Value << 0);
+            Ppu->Address = Ppu->TempAddress;
+            // NOTE: Rest of the scanline continues from the new address
+            if (Ppu->Dot > 0 && Ppu->Dot < PpuVisibleDotEnd) {
+                Ppu->LineOriginX = Ppu->LineX;
+            }
+            Ppu->AddressLatch = 0;
         } else {
-            Bus->Ppu->TempAddress = (Bus->Ppu->TempAddress & 0x00FF) | (Value << 8);
-            Bus->Ppu->Address = Bus->Ppu->TempAddress;
-            Bus->Ppu->AddressLatch = 1;
+            Ppu->TempAddress = (Ppu->TempAddress & 0x00FF) | ((Value & 0b00111111) << 8);
+            Ppu->AddressLatch = 1;
         }
     } else if (PpuRegister == PPUDATA) {
-        PpuWrite(Bus, Bus->Ppu->Address, Value);
-        u16 IncrementAmount = (Bus->Ppu->Control & IncrementModeMask) ? 32 : 1;
-        Bus->Ppu->Address += IncrementAmount;
+        PpuWrite(Bus, Ppu->Address & VramAddressMask, Value);
+        u16 IncrementAmount = (Ppu->Control & IncrementModeMask) ? 32 : 1;
+        Ppu->Address += IncrementAmount;
     } else {
         MemoryAccessTrap(Address, Value, "No writing here!");
     }
@@ -0,0 +1,78 @@
+#ifndef _EMU_PROFILER_H
+#define _EMU_PROFILER_H
+
+#include "base.h"
+
+// NOTE: Timed blocks are compiled in only with PROFILE=1, otherwise
+//       BeginTimedBlock/EndTimedBlock expand to nothing.
+//       Blocks measure inclusive time, so nested blocks overlap their parent.
+
+typedef enum profile_block_id {
+    ProfileBlock_CpuCore,
+    ProfileBlock_BusRead,
+    ProfileBlock_BusWrite,
+    ProfileBlock_PpuCatchUp,
+    ProfileBlock_DrawRam,
+    ProfileBlock_DrawCode,
+    ProfileBlock_PatternTables,
+    ProfileBlock_NameTables,
+    ProfileBlock_Count,
+} profile_block_id;
+
+typedef struct profile_block {
+    u64 Counter;
+    u64 HitCount;
+} profile_block;
+
+global_variable profile_block GlobalProfileBlocks[ProfileBlock_Count];
+
+internal char*
+ProfileBlockName(profile_block_id Id) {
+    switch (Id) {
+        case ProfileBlock_CpuCore      : return "CpuCore";
+        case ProfileBlock_BusRead      : return "BusRead";
+        case ProfileBlock_BusWrite     : return "BusWrite";
+        case ProfileBlock_PpuCatchUp   : return "PpuCatchUp";
+        case ProfileBlock_DrawRam      : return "DrawRam";
+        case ProfileBlock_DrawCode     : return "DrawCode";
+        case ProfileBlock_PatternTables: return "PatternTables";
+        case ProfileBlock_NameTables   : return "NameTables";
+        default                        : return "???";
+    }
+}
+
+#if PROFILE
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ProfilerReadCounter() ((u64)__rdtsc())
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ProfilerReadCounter() ((u64)__rdtsc())
+#else
+#define ProfilerReadCounter() PlatformTimeNanoseconds()
+#endif
+
+#define BeginTimedBlock(Id) u64 StartCounter##Id = ProfilerReadCounter()
+#define EndTimedBlock(Id) {\
+    GlobalProfileBlocks[ProfileBlock_##Id].Counter += ProfilerReadCounter() - StartCounter##Id;\
+    GlobalProfileBlocks[ProfileBlock_##Id].HitCount++;\
+}\
+
+#else
+
+#define ProfilerReadCounter() (0ULL)
+#define BeginTimedBlock(Id)
+#define EndTimedBlock(Id)
+
+#endif
+
+internal void
+ProfilerReset(void) {
+    for (i32 BlockIndex = 0; BlockIndex < ProfileBlock_Count; BlockIndex++) {
+        GlobalProfileBlocks[BlockIndex].Counter = 0;
+        GlobalProfileBlocks[BlockIndex].HitCount = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef _EMU_REWIND_H
+#define _EMU_REWIND_H
+
+#include "base.h"
+#include "emu_types.h"
+#include "bus.h"
+#include "emulator.h"
+#include "save_state.h"
+#include "arena.h"
+#include "lz.h"
+
+#include <string.h>
+
+/*
+
+    Rewind buffer. One entry per captured frame in a byte ring (Arena). Every
+    KeyframeInterval frames the entry is a keyframe, the whole save state
+    compressed. Entries in between are the save state XOR that keyframe,
+    mostly zeros, compressed.
+
+    When the arena is full the oldest keyframe goes away together with all
+    the deltas against it. KeyState always holds the keyframe of the newest
+    entry decompressed, so capturing never has to decompress anything.
+
+*/
+
+#define RewindDefaultArenaSize        (Megabytes(16))
+#define RewindDefaultEntryCount       (1 << 16)
+#define RewindDefaultKeyframeInterval (60)
+
+typedef struct rewind_entry {
+    u32 Offset;
+    u32 Size;
+    bool32 Keyframe;
+} rewind_entry;
+
+typedef struct rewind_buffer {
+    u8* Arena;
+    u32 ArenaSize;
+    u32 ArenaTail;
+    rewind_entry* Entries;
+    u32 EntryCapacity;
+    u32 EntryHead;
+    u32 EntryCount;
+    i32 KeyframeInterval;
+    // NOTE: Frames captured since the newest keyframe
+    i32 KeyframeAge;
+    bool32 KeyStateValid;
+    save_state* KeyState;
+    save_state* Scratch;
+    u8* Compressed;
+    // NOTE: Stats
+    u32 UsedBytes;
+    u64 CaptureCount;
+    u64 CaptureNanoseconds;
+    u64 CapturedBytes;
+} rewind_buffer;
+
+internal void
+RewindInit(rewind_buffer* Rewind, memory_arena* Arena,
+           u32 ArenaSize, u32 EntryCapacity, i32 KeyframeInterval) {
+    memset(Rewind, 0, sizeof(*Rewind));
+    Rewind->Arena = ArenaPushArray(Arena, u8, ArenaSize);
+    Rewind->ArenaSize = ArenaSize;
+    Rewind->Entries = ArenaPushArray(Arena, rewind_entry, EntryCapacity);
+    Rewind->EntryCapacity = EntryCapacity;
+    Rewind->KeyframeInterval = KeyframeInterval;
+    Rewind->KeyState = ArenaPushStruct(Arena, save_state);
+    Rewind->Scratch = ArenaPushStruct(Arena, save_state);
+    Rewind->Compressed = ArenaPushArray(Arena, u8, LzBound(sizeof(save_state)));
+}
+
+internal rewind_entry*
+RewindEntry(rewind_buffer* Rewind, u32 Index) {
+    return Rewind->Entries + ((Rewind->EntryHead + Index) % Rewind->EntryCapacity);
+}
+
+internal void
+RewindEvictOldestGroup(rewind_buffer* Rewind) {
+    do {
+        rewind_entry* Entry = RewindEntry(Rewind, 0);
+        Rewind->UsedBytes -= Entry->Size;
+        Rewind->EntryHead = (Rewind->EntryHead + 1) % Rewind->EntryCapacity;
+        Rewind->EntryCount--;
+    } while (Rewind->EntryCount && !RewindEntry(Rewind, 0)->Keyframe);
+
+    if (!Rewind->EntryCount) {
+        Rewind->KeyStateValid = 0;
+    }
+}
+
+// NOTE: Arena offset for Size more bytes, evicts old groups until they fit.
+//       Returns ArenaSize when Size can't fit at all.
+internal u32
+RewindAllocate(rewind_buffer* Rewind, u32 Size) {
+    if (Size >= Rewind->ArenaSize) {
+        return Rewind->ArenaSize;
+    }
+    while (Rewind->EntryCount) {
+        u32 Oldest = RewindEntry(Rewind, 0)->Offset;
+        if (Rewind->EntryCount < Rewind->EntryCapacity) {
+            if (Rewind->ArenaTail >= Oldest) {
+                if (Rewind->ArenaTail + Size <= Rewind->ArenaSize) {
+                    return Rewind->ArenaTail;
+                }
+                if (Size < Oldest) {
+                    return 0;
+                }
+            } else if (Rewind->ArenaTail + Size < Oldest) {
+                return Rewind->ArenaTail;
+            }
+        }
+        RewindEvictOldestGroup(Rewind);
+    }
+    return 0;
+}
+
+internal void
+RewindPush(rewind_buffer* Rewind, u32 Offset, u32 Size, bool32 Keyframe) {
+    rewind_entry* Entry = RewindEntry(Rewind, Rewind->EntryCount);
+    Entry->Offset = Offset;
+    Entry->Size = Size;
+    Entry->Keyframe = Keyframe;
+    Rewind->EntryCount++;
+    Rewind->ArenaTail = Offset + Size;
+    Rewind->UsedBytes += Size;
+    Rewind->CapturedBytes += Size;
+}
+
+internal void
+RewindXor(save_state* Destination, save_state* Source) {
+    u64* DestinationWords = (u64*)Destination;
+    u64* SourceWords = (u64*)Source;
+    for (u32 Index = 0; Index < sizeof(save_state) / sizeof(u64); Index++) {
+        DestinationWords[Index] ^= SourceWords[Index];
+    }
+}
+
+internal bool32
+RewindStoreKeyframe(rewind_buffer* Rewind) {
+    u32 Size = (u32)LzCompress(Rewind->Compressed, (u8*)Rewind->KeyState, sizeof(save_state));
+    u32 Offset = RewindAllocate(Rewind, Size);
+    if (Offset == Rewind->ArenaSize) {
+        return 0;
+    }
+    memcpy(Rewind->Arena + Offset, Rewind->Compressed, Size);
+    RewindPush(Rewind, Offset, Size, 1);
+    Rewind->KeyStateValid = 1;
+    Rewind->KeyframeAge = 0;
+    return 1;
+}
+
+// NOTE: Call once per frame (or per step between which rewinding is wanted)
+internal void
+RewindCapture(rewind_buffer* Rewind, machine_state* Machine, bus* Bus) {
+    u64 Start = PlatformTimeNanoseconds();
+
+    if (!Rewind->KeyStateValid || Rewind->KeyframeAge + 1 >= Rewind->KeyframeInterval) {
+        SaveStateCapture(Rewind->KeyState, Machine, Bus);
+        RewindStoreKeyframe(Rewind);
+    } else {
+        SaveStateCapture(Rewind->Scratch, Machine, Bus);
+        RewindXor(Rewind->Scratch, Rewind->KeyState);
+        u32 Size = (u32)LzCompress(Rewind->Compressed, (u8*)Rewind->Scratch, sizeof(save_state));
+        u32 Offset = RewindAllocate(Rewind, Size);
+        if (Rewind->KeyStateValid && Offset != Rewind->ArenaSize) {
+            memcpy(Rewind->Arena + Offset, Rewind->Compressed, Size);
+            RewindPush(Rewind, Offset, Size, 0);
+            Rewind->KeyframeAge++;
+        } else {
+            // NOTE: Making room took our own keyframe, start a new group
+            SaveStateCapture(Rewind->KeyState, Machine, Bus);
+            RewindStoreKeyframe(Rewind);
+        }
+    }
+
+    Rewind->CaptureCount++;
+    Rewind->CaptureNanoseconds += PlatformTimeNanoseconds() - Start;
+}
+
+internal bool32
+RewindDecompress(rewind_buffer* Rewind, rewind_entry* Entry, save_state* Destination) {
+    return LzDecompress((u8*)Destination, sizeof(save_state),
+                        Rewind->Arena + Entry->Offset, Entry->Size) == sizeof(save_state);
+}
+
+// NOTE: Drops the newest entry (the frame the machine is on) and restores
+//       the one before it. Returns 0 when there is nothing older left.
+internal bool32
+RewindStep(rewind_buffer* Rewind, machine_state* Machine, bus* Bus) {
+    if (Rewind->EntryCount < 2) {
+        return 0;
+    }
+
+    rewind_entry* Dropped = RewindEntry(Rewind, Rewind->EntryCount - 1);
+    Rewind->UsedBytes -= Dropped->Size;
+    Rewind->ArenaTail = Dropped->Offset;
+    Rewind->EntryCount--;
+    if (Dropped->Keyframe) {
+        Rewind->KeyStateValid = 0;
+    }
+
+    // NOTE: Find the keyframe of the newest group again after crossing into it
+    u32 KeyIndex = Rewind->EntryCount - 1;
+    while (!RewindEntry(Rewind, KeyIndex)->Keyframe) {
+        KeyIndex--;
+    }
+    if (!Rewind->KeyStateValid) {
+        if (!RewindDecompress(Rewind, RewindEntry(Rewind, KeyIndex), Rewind->KeyState)) {
+            return 0;
+        }
+        Rewind->KeyStateValid = 1;
+    }
+    Rewind->KeyframeAge = (i32)(Rewind->EntryCount - 1 - KeyIndex);
+
+    rewind_entry* Newest = RewindEntry(Rewind, Rewind->EntryCount - 1);
+    if (Newest->Keyframe) {
+        return SaveStateRestore(Rewind->KeyState, Machine, Bus);
+    }
+    if (!RewindDecompress(Rewind, Newest, Rewind->Scratch)) {
+        return 0;
+    }
+    RewindXor(Rewind->Scratch, Rewind->KeyState);
+    return SaveStateRestore(Rewind->Scratch, Machine, Bus);
+}
+
+#endif
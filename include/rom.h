@@ -4,10 +4,18 @@
 #include "base.h"
 #include "emu_types.h"
 #include "file_io.h"
+#include "crc32.h"
+#include "rom_database.h"
 
-#define MapperNROM (0)
+#define MapperNROM  (0)
+#define MapperMMC1  (1)
+#define MapperUxROM (2)
+#define MapperCNROM (3)
+#define MapperMMC3  (4)
+#define MapperAxROM (7)
 
 #define RamSize (1024 * 2)
+#define PrgRamSize (1024 * 8)
 #define PrgBankSize (16384)
 #define ChrBankSize (1024 * 8)
 
@@ -17,6 +25,9 @@
 #define INesChrBanksCount (5)
 #define INesFlags6        (6)
 #define INesFlags7        (7)
+#define Nes20Mapper       (8)
+#define Nes20RomSizeHigh  (9)
+#define Nes20PrgRamSize   (10)
 
 #define INesFlags6Mirroring       (0b00000001)
 #define INesFlags6PrgRam          (0b00000010)
@@ -25,29 +36,130 @@
 #define INesFlags6MapperIdLow     (0b11110000)
 
 #define INesFlags7MapperIdHigh    (0b11110000)
+#define INesFlags7Format          (0b00001100)
+#define INesFlags7FormatNes20     (0b00001000)
 
-internal rom ParseRom(loaded_file LoadedFile) {
+#define Nes20MapperIdHighest      (0b00001111)
+#define Nes20Submapper            (0b11110000)
+#define Nes20PrgRomSizeHigh       (0b00001111)
+#define Nes20ChrRomSizeHigh       (0b11110000)
+#define Nes20PrgRamShift          (0b00001111)
+#define Nes20PrgNvramShift        (0b11110000)
+
+internal bool32
+RomMapperSupported(u32 MapperId) {
+    return MapperId == MapperNROM ||
+           MapperId == MapperMMC1 ||
+           MapperId == MapperUxROM ||
+           MapperId == MapperCNROM ||
+           MapperId == MapperMMC3 ||
+           MapperId == MapperAxROM;
+}
+
+// NOTE: NES 2.0 ROM size, Low is the iNES byte and High the nibble from
+//       byte 9. High 0xF is exponent-multiplier notation, 2^E * (M*2+1).
+internal size_t
+Nes20RomSize(u8 Low, u8 High, size_t BankSize) {
+    if (High == 0xF) {
+        return ((size_t)1 << (Low >> 2)) * (((Low & 0b11) * 2) + 1);
+    }
+    return (((size_t)High << 8) | Low) * BankSize;
+}
+
+// NOTE: NES 2.0 RAM sizes are 64 << shift, shift 0 means none
+internal u32
+Nes20RamSize(u8 Shift) {
+    return Shift ? (64u << Shift) : 0;
+}
+
+// NOTE: Rom points into LoadedFile, which has to outlive it. Returns 0 when
+//       the file is not an iNES ROM, is shorter than its header says or uses a
+//       mapper that isn't supported. Known dumps get their header corrected
+//       from the ROM database.
+internal bool32
+ParseRom(loaded_file LoadedFile, rom* Rom) {
     rom Result = {0};
 
-    Result.PrgRomBankCount = LoadedFile.Data[INesPrgBanksCount];
-    Result.ChrRomBankCount = LoadedFile.Data[INesChrBanksCount];
-    Result.MapperId = (LoadedFile.Data[INesFlags7] & INesFlags7MapperIdHigh) | ((LoadedFile.Data[INesFlags6] & INesFlags6MapperIdLow) >> 4);
-    Result.Mirroring = (LoadedFile.Data[INesFlags6] & INesFlags6Mirroring) ? Vertical : Horizontal;
-    Result.IgnoreMirroring = LoadedFile.Data[INesFlags6] & INesFlags6IgnoreMirroring;
-    Result.HasPrgRam = LoadedFile.Data[INesFlags6] & INesFlags6PrgRam;
-    Result.HasTrainer = LoadedFile.Data[INesFlags6] & INesFlags6Trainer;
+    if (!LoadedFile.Data || LoadedFile.Size < INesHeaderSize ||
+        LoadedFile.Data[0] != 0x4E || LoadedFile.Data[1] != 0x45 ||
+        LoadedFile.Data[2] != 0x53 || LoadedFile.Data[3] != 0x1A) {
+        return 0;
+    }
+
+    u8* Header = LoadedFile.Data;
+    Result.Nes20 = (Header[INesFlags7] & INesFlags7Format) == INesFlags7FormatNes20;
+    Result.MapperId = (Header[INesFlags6] & INesFlags6MapperIdLow) >> 4;
+    Result.Mirroring = (Header[INesFlags6] & INesFlags6Mirroring) ? Vertical : Horizontal;
+    Result.IgnoreMirroring = Header[INesFlags6] & INesFlags6IgnoreMirroring;
+    Result.HasBattery = Header[INesFlags6] & INesFlags6PrgRam;
+    Result.HasPrgRam = Result.HasBattery;
+    Result.HasTrainer = Header[INesFlags6] & INesFlags6Trainer;
+
+    size_t PrgRomSize;
+    size_t ChrRomSize;
+    if (Result.Nes20) {
+        Result.MapperId |= (Header[INesFlags7] & INesFlags7MapperIdHigh) |
+                           ((Header[Nes20Mapper] & Nes20MapperIdHighest) << 8);
+        Result.SubmapperId = (Header[Nes20Mapper] & Nes20Submapper) >> 4;
+        PrgRomSize = Nes20RomSize(Header[INesPrgBanksCount],
+                                  Header[Nes20RomSizeHigh] & Nes20PrgRomSizeHigh, PrgBankSize);
+        ChrRomSize = Nes20RomSize(Header[INesChrBanksCount],
+                                  (Header[Nes20RomSizeHigh] & Nes20ChrRomSizeHigh) >> 4, ChrBankSize);
+        u32 PrgNvramBytes = Nes20RamSize((Header[Nes20PrgRamSize] & Nes20PrgNvramShift) >> 4);
+        Result.PrgRamBytes = Nes20RamSize(Header[Nes20PrgRamSize] & Nes20PrgRamShift) + PrgNvramBytes;
+        Result.PrgRamSizeKnown = 1;
+        Result.HasPrgRam = (Result.PrgRamBytes > 0);
+        Result.HasBattery = Result.HasBattery || (PrgNvramBytes > 0);
+    } else {
+        // NOTE: Old dumps have garbage like "DiskDude!" from byte 7 on, the
+        //       high mapper nibble is only trusted when bytes 12-15 are clear
+        if (!Header[12] && !Header[13] && !Header[14] && !Header[15]) {
+            Result.MapperId |= Header[INesFlags7] & INesFlags7MapperIdHigh;
+        }
+        PrgRomSize = (size_t)Header[INesPrgBanksCount] * PrgBankSize;
+        ChrRomSize = (size_t)Header[INesChrBanksCount] * ChrBankSize;
+    }
+
+    // NOTE: Banks are switched in whole 16KB/8KB units, odd sizes aren't
+    //       supported
+    if (PrgRomSize == 0 || (PrgRomSize % PrgBankSize) || (ChrRomSize % ChrBankSize)) {
+        return 0;
+    }
+    Result.PrgRomBankCount = (u32)(PrgRomSize / PrgBankSize);
+    Result.ChrRomBankCount = (u32)(ChrRomSize / ChrBankSize);
+    // NOTE: No CHR-ROM means 8KB of CHR-RAM, caller provides the memory
+    Result.HasChrRam = (Result.ChrRomBankCount == 0);
+
+    size_t PrgOffset = INesHeaderSize + ((Result.HasTrainer) ? INesTrainerSize : 0);
+    size_t ChrOffset = PrgOffset + PrgRomSize;
+    size_t EndOffset = ChrOffset + ChrRomSize;
+    if (LoadedFile.Size < EndOffset) {
+        return 0;
+    }
 
-    u8* PrgSectionStart =
-        LoadedFile.Data +
-        INesHeaderSize + ((Result.HasTrainer) ? INesTrainerSize : 0);
+    Result.Prg = LoadedFile.Data + PrgOffset;
+    Result.Chr = LoadedFile.Data + ChrOffset;
 
-    Result.Prg = PrgSectionStart;
-    Result.Chr = PrgSectionStart + (PrgBankSize * Result.PrgRomBankCount);
+    Result.Crc32 = Crc32(Result.Prg, PrgRomSize + ChrRomSize);
+    rom_database_entry* Entry = RomDatabaseFind(Result.Crc32);
+    if (Entry) {
+        Result.InDatabase = 1;
+        Result.MapperId = Entry->MapperId;
+        Result.SubmapperId = Entry->SubmapperId;
+        Result.Mirroring = (Entry->Mirroring == RomDatabaseVertical) ? Vertical : Horizontal;
+        Result.IgnoreMirroring = (Entry->Mirroring == RomDatabaseFourScreen);
+        Result.PrgRamBytes = (u32)Entry->PrgRamKilobytes * 1024;
+        Result.PrgRamSizeKnown = 1;
+        Result.HasPrgRam = (Result.PrgRamBytes > 0);
+        Result.HasBattery = Entry->Battery;
+    }
 
-    Assert(!Result.HasPrgRam);
-    Assert(Result.MapperId == MapperNROM);
+    if (!RomMapperSupported(Result.MapperId)) {
+        return 0;
+    }
 
-    return Result;
+    *Rom = Result;
+    return 1;
 }
 
 #endif
@@ -0,0 +1,173 @@
+#ifndef _EMU_ROM_DATABASE_H
+#define _EMU_ROM_DATABASE_H
+
+#include "base.h"
+#include "file_io.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+
+    ROM database, corrects header metadata of known dumps. Keyed by the
+    CRC-32 of PRG-ROM followed by CHR-ROM (no header, no trainer), which is
+    the "rom" CRC of No-Intro and NES 2.0 XML databases.
+
+    Entries live in an open addressed table, CRC & mask is the first slot and
+    probing is linear. CRCs are already uniform so no extra hashing.
+
+    More entries can be loaded from a text file (RomDatabaseLoad), one per
+    line, '#' starts a comment:
+
+        crc32(hex) mapper submapper mirroring(h|v|4) prg_ram_kb battery(0|1)
+
+    Later entries replace earlier ones with the same CRC.
+
+    The built-in list is only a seed that shows the entry format, it holds no
+    corrections. Fixing bad headers needs a database file passed with -romdb,
+    e.g. one generated from the NES 2.0 XML database.
+
+*/
+
+#define RomDatabaseMaxEntryCount (1 << 14)
+#define RomDatabaseSlotCount     (RomDatabaseMaxEntryCount * 2)
+
+#define RomDatabaseHorizontal (0)
+#define RomDatabaseVertical   (1)
+#define RomDatabaseFourScreen (2)
+
+typedef struct rom_database_entry {
+    u32 Crc32;
+    u16 MapperId;
+    u8 SubmapperId;
+    u8 Mirroring;
+    u8 PrgRamKilobytes;
+    u8 Battery;
+} rom_database_entry;
+
+global_variable rom_database_entry RomDatabaseBuiltIn[] = {
+    // NOTE: Super Mario Bros. (World), its header is already right
+    {0x3337EC46, 0, 0, RomDatabaseVertical, 0, 0},
+};
+
+global_variable rom_database_entry RomDatabaseEntries[RomDatabaseMaxEntryCount];
+global_variable u32 RomDatabaseEntryCount;
+// NOTE: Entry index + 1, 0 is empty
+global_variable u16 RomDatabaseSlots[RomDatabaseSlotCount];
+global_variable bool32 RomDatabaseReady;
+
+// NOTE: Slot holding Crc32, or the empty slot where it would go
+internal u32
+RomDatabaseProbe(u32 Crc32) {
+    u32 Slot = Crc32 & (RomDatabaseSlotCount - 1);
+    while (RomDatabaseSlots[Slot] &&
+           RomDatabaseEntries[RomDatabaseSlots[Slot] - 1].Crc32 != Crc32) {
+        Slot = (Slot + 1) & (RomDatabaseSlotCount - 1);
+    }
+    return Slot;
+}
+
+internal bool32
+RomDatabaseInsert(rom_database_entry* Entry) {
+    u32 Slot = RomDatabaseProbe(Entry->Crc32);
+    if (RomDatabaseSlots[Slot]) {
+        RomDatabaseEntries[RomDatabaseSlots[Slot] - 1] = *Entry;
+        return 1;
+    }
+    if (RomDatabaseEntryCount == RomDatabaseMaxEntryCount) {
+        return 0;
+    }
+    RomDatabaseEntries[RomDatabaseEntryCount++] = *Entry;
+    RomDatabaseSlots[Slot] = (u16)RomDatabaseEntryCount;
+    return 1;
+}
+
+internal void
+RomDatabaseInit(void) {
+    if (RomDatabaseReady) {
+        return;
+    }
+    RomDatabaseReady = 1;
+    for (u32 EntryIndex = 0; EntryIndex < ArrayCount(RomDatabaseBuiltIn); EntryIndex++) {
+        RomDatabaseInsert(RomDatabaseBuiltIn + EntryIndex);
+    }
+}
+
+internal bool32
+RomDatabaseAdd(rom_database_entry* Entry) {
+    RomDatabaseInit();
+    return RomDatabaseInsert(Entry);
+}
+
+internal rom_database_entry*
+RomDatabaseFind(u32 Crc32) {
+    RomDatabaseInit();
+    u32 Slot = RomDatabaseProbe(Crc32);
+    return RomDatabaseSlots[Slot] ? RomDatabaseEntries + (RomDatabaseSlots[Slot] - 1) : 0;
+}
+
+// NOTE: Returns the number of entries added, lines that don't parse are
+//       skipped. -1 when the file can't be read.
+internal i32
+RomDatabaseLoad(char* FileName) {
+    loaded_file File = MapFile(FileName);
+    if (!File.Data) {
+        return -1;
+    }
+
+    i32 Result = 0;
+    size_t Position = 0;
+    while (Position < File.Size) {
+        char Line[256];
+        size_t LineLength = 0;
+        while (Position < File.Size && File.Data[Position] != '\n') {
+            if (LineLength < sizeof(Line) - 1) {
+                Line[LineLength++] = (char)File.Data[Position];
+            }
+            Position++;
+        }
+        Position++;
+        Line[LineLength] = 0;
+
+        char* Comment = strchr(Line, '#');
+        if (Comment) {
+            *Comment = 0;
+        }
+
+        unsigned int Crc32;
+        unsigned int MapperId;
+        unsigned int SubmapperId;
+        char Mirroring;
+        unsigned int PrgRamKilobytes;
+        unsigned int Battery;
+        if (sscanf(Line, "%x %u %u %c %u %u", &Crc32, &MapperId, &SubmapperId,
+                   &Mirroring, &PrgRamKilobytes, &Battery) != 6 ||
+            MapperId > 0xFFF || SubmapperId > 0xF || PrgRamKilobytes > 0xFF) {
+            continue;
+        }
+
+        rom_database_entry Entry = {0};
+        Entry.Crc32 = Crc32;
+        Entry.MapperId = (u16)MapperId;
+        Entry.SubmapperId = (u8)SubmapperId;
+        Entry.PrgRamKilobytes = (u8)PrgRamKilobytes;
+        Entry.Battery = (Battery != 0);
+        if (Mirroring == 'h' || Mirroring == 'H') {
+            Entry.Mirroring = RomDatabaseHorizontal;
+        } else if (Mirroring == 'v' || Mirroring == 'V') {
+            Entry.Mirroring = RomDatabaseVertical;
+        } else if (Mirroring == '4') {
+            Entry.Mirroring = RomDatabaseFourScreen;
+        } else {
+            continue;
+        }
+        if (RomDatabaseAdd(&Entry)) {
+            Result++;
+        }
+    }
+
+    UnmapFile(&File);
+    return Result;
+}
+
+#endif
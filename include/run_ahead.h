@@ -0,0 +1,75 @@
+#ifndef _EMU_RUN_AHEAD_H
+#define _EMU_RUN_AHEAD_H
+
+#include "base.h"
+#include "emu_types.h"
+#include "bus.h"
+#include "emulator.h"
+#include "save_state.h"
+#include "arena.h"
+
+/*
+
+    Run-ahead. The real frame runs without drawing, the machine is saved,
+    FrameCount more frames run with the same input and only the last one is
+    drawn, then the save goes back. A game that reacts to input N frames late
+    shows the reaction on the frame it was pressed.
+
+    Speculative frames are not traced. CDL still picks them up, code run
+    ahead is code that runs a frame later anyway.
+
+*/
+
+#define RunAheadMaxFrameCount (4)
+
+typedef struct run_ahead {
+    i32 FrameCount;
+    save_state* Slot;
+    // NOTE: Stats, time spent on top of the real frame
+    u64 RunCount;
+    u64 ExtraNanoseconds;
+} run_ahead;
+
+internal void
+RunAheadInit(run_ahead* RunAhead, memory_arena* Arena, i32 FrameCount) {
+    memset(RunAhead, 0, sizeof(*RunAhead));
+    if (FrameCount > RunAheadMaxFrameCount) {
+        FrameCount = RunAheadMaxFrameCount;
+    }
+    RunAhead->FrameCount = FrameCount;
+    if (FrameCount > 0) {
+        RunAhead->Slot = ArenaPushStruct(Arena, save_state);
+    }
+}
+
+// NOTE: Replaces GlobalFrame. The machine ends on the real frame, the screen
+//       holds the frame FrameCount ahead of it.
+internal void
+RunAheadFrame(run_ahead* RunAhead, machine_state* Machine, bus* Bus) {
+    if (RunAhead->FrameCount <= 0) {
+        GlobalFrame(&Machine->Cpu, &Machine->Pins, Bus);
+        return;
+    }
+
+    pixel_buffer* Screen = Bus->Screen;
+    Bus->Screen = 0;
+    GlobalFrame(&Machine->Cpu, &Machine->Pins, Bus);
+
+    u64 Start = PlatformTimeNanoseconds();
+    trace_buffer* Trace = Bus->Trace;
+    Bus->Trace = 0;
+    SaveStateCapture(RunAhead->Slot, Machine, Bus);
+    for (i32 Frame = 1; Frame <= RunAhead->FrameCount; Frame++) {
+        if (Frame == RunAhead->FrameCount) {
+            Bus->Screen = Screen;
+        }
+        GlobalFrame(&Machine->Cpu, &Machine->Pins, Bus);
+    }
+    SaveStateRestore(RunAhead->Slot, Machine, Bus);
+    Bus->Trace = Trace;
+
+    RunAhead->RunCount++;
+    RunAhead->ExtraNanoseconds += PlatformTimeNanoseconds() - Start;
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef _EMU_SAVE_STATE_H
+#define _EMU_SAVE_STATE_H
+
+#include "base.h"
+#include "emu_types.h"
+#include "bus.h"
+#include "rom.h"
+#include "ppu.h"
+#include "emulator.h"
+#include "file_io.h"
+
+#include "m6502.h"
+
+#include <string.h>
+
+/*
+
+    Save states. A slot is a header followed by the scheduler and the whole
+    machine_state block, files are the same bytes. Saving is a memcpy, loading
+    is a memcpy plus re-deriving what is not state:
+
+    - pointers (m6502 callbacks, bus pages) come from the running machine,
+    - CpuCore is a setting and stays as it is,
+    - CHR cache tiles are invalidated where CHR-RAM differs,
+    - battery PRG-RAM lives in the mapped .sav (battery_save.h), it is copied
+      into the block's PrgRam on save and back out on load.
+
+    Layout of machine_state is the format, Version has to go up whenever it
+    changes. Size catches the cases where that was forgotten. RomCrc32 is the
+    CRC-32 of the ROM's PRG and CHR (rom.h), a state only loads on the ROM it
+    was saved from.
+
+    Versions: 1 first format, 2 mapper registers for MMC1/MMC3, 3 RomCrc32 in
+    the header, 4 MMC1 ShiftClock, 5 fast core IRQ flag delay.
+
+*/
+
+#define SaveStateMagic   (0x5641534E)
+#define SaveStateVersion (5)
+
+typedef struct save_state_header {
+    u32 Magic;
+    u32 Version;
+    u32 Size;
+    u32 RomCrc32;
+} save_state_header;
+
+typedef struct save_state {
+    save_state_header Header;
+    scheduler Scheduler;
+    machine_state Machine;
+} save_state;
+
+internal void
+SaveStateCapture(save_state* Slot, machine_state* Machine, bus* Bus) {
+    Slot->Header.Magic = SaveStateMagic;
+    Slot->Header.Version = SaveStateVersion;
+    Slot->Header.Size = sizeof(save_state);
+    Slot->Header.RomCrc32 = Bus->Rom->Crc32;
+    Slot->Scheduler = Bus->Scheduler;
+    memcpy(&Slot->Machine, Machine, sizeof(machine_state));
+    if (Bus->PrgRam && Bus->PrgRam != Machine->PrgRam) {
+        memcpy(Slot->Machine.PrgRam, Bus->PrgRam, PrgRamSize);
+    }
+}
+
+internal bool32
+SaveStateIsValid(save_state* Slot, size_t Size, bus* Bus) {
+    return Size >= sizeof(save_state) &&
+           Slot->Header.Magic == SaveStateMagic &&
+           Slot->Header.Version == SaveStateVersion &&
+           Slot->Header.Size == sizeof(save_state) &&
+           Slot->Header.RomCrc32 == Bus->Rom->Crc32;
+}
+
+internal bool32
+SaveStateRestore(save_state* Slot, machine_state* Machine, bus* Bus) {
+    if (!SaveStateIsValid(Slot, sizeof(save_state), Bus)) {
+        return 0;
+    }
+
+    // NOTE: CHR-RAM tiles that differ, where they are mapped right now. Slots
+    //       that get other banks are invalidated by BusMapMemory.
+    if (Bus->Rom->HasChrRam) {
+        for (u32 ChrSlot = 0; ChrSlot < MapperChrSlotCount; ChrSlot++) {
+            u32 RamOffset = (u32)(Bus->ChrBanks[ChrSlot] - Machine->ChrRam);
+            for (u32 Offset = 0; Offset < MapperChrSlotSize; Offset += PatternSizeInBytes) {
+                if (memcmp(Machine->ChrRam + RamOffset + Offset,
+                           Slot->Machine.ChrRam + RamOffset + Offset, PatternSizeInBytes) != 0) {
+                    ChrCacheInvalidate(Bus->ChrCache, (u16)((ChrSlot * MapperChrSlotSize) + Offset), PatternSizeInBytes);
+                }
+            }
+        }
+    }
+
+    m6502_t Cpu = Machine->Cpu;
+    cpu_core CpuCore = Bus->Scheduler.CpuCore;
+
+    memcpy(Machine, &Slot->Machine, sizeof(machine_state));
+    Bus->Scheduler = Slot->Scheduler;
+    if (Bus->PrgRam && Bus->PrgRam != Machine->PrgRam) {
+        memcpy(Bus->PrgRam, Machine->PrgRam, PrgRamSize);
+    }
+
+    Machine->Cpu.user_data = Cpu.user_data;
+    Machine->Cpu.in_cb = Cpu.in_cb;
+    Machine->Cpu.out_cb = Cpu.out_cb;
+    Bus->Scheduler.CpuCore = CpuCore;
+    BusMapMemory(Bus);
+    return 1;
+}
+
+internal bool32
+SaveStateWriteFile(char* FileName, save_state* Slot) {
+    return SaveFile(FileName, Slot, sizeof(save_state));
+}
+
+// NOTE: Restores straight from the mapped file, no intermediate copy
+internal bool32
+SaveStateLoadFile(char* FileName, machine_state* Machine, bus* Bus) {
+    loaded_file File = MapFile(FileName);
+    bool32 Result = 0;
+    if (File.Data && SaveStateIsValid((save_state*)File.Data, File.Size, Bus)) {
+        Result = SaveStateRestore((save_state*)File.Data, Machine, Bus);
+    }
+    UnmapFile(&File);
+    return Result;
+}
+
+#endif
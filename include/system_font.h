@@ -4,6 +4,8 @@
 #include "base.h"
 #include "gfx.h"
 
+#include <string.h>
+
 // Font taken from https://github.com/floooh/sokol/blob/master/util/sokol_debugtext.h
 
 /* For reference
@@ -541,51 +543,148 @@ global_variable u8 C64[2048] = {
 #define EmbeddedFontHeight (EmbeddedFontWidth)
 #define EmbeddedFont (C64)
 
+#define GlyphCount           (256)
+#define GlyphPixelCount      (EmbeddedFontWidth * EmbeddedFontHeight)
+#define GlyphAtlasCacheCount (16)
+#define TextForeground       (0xFFFFFFFF)
+#define TextBackground       (0xFF000000)
+
+// NOTE: Every glyph expanded to 8x8 u32 pixels in one colour pair, drawing
+//       a character is eight row copies. Atlases are made on first use of a
+//       pair from GlyphMasks and kept in a small cache, the least recently
+//       used one is rebuilt when a new pair comes along.
+typedef struct glyph_atlas {
+    bool32 Valid;
+    u32 Foreground;
+    u32 Background;
+    u64 LastUse;
+    u32 Pixels[GlyphCount][GlyphPixelCount];
+} glyph_atlas;
+
+// NOTE: Font bits expanded to all ones/all zeros pixels, built once
+global_variable u32 GlyphMasks[GlyphCount][GlyphPixelCount];
+global_variable bool32 GlyphMasksReady;
+global_variable glyph_atlas GlyphAtlases[GlyphAtlasCacheCount];
+global_variable glyph_atlas* GlyphAtlasLast;
+global_variable u64 GlyphAtlasUseCount;
+
 internal void
-PutChar(pixel_buffer* Dest, i32 CellX, i32 CellY, u8 Char) {
-    i32 MaxCellX = (Dest->Width / EmbeddedFontWidth) - 1;
-    i32 MaxCellY = (Dest->Height / EmbeddedFontHeight) - 1;
+GlyphMasksBuild(void) {
+    for (i32 Glyph = 0; Glyph < GlyphCount; Glyph++) {
+        u8* CharRow = EmbeddedFont + (EmbeddedFontHeight * Glyph);
+        for (i32 Y = 0; Y < EmbeddedFontHeight; Y++) {
+            for (i32 X = 0; X < EmbeddedFontWidth; X++) {
+                GlyphMasks[Glyph][(Y * EmbeddedFontWidth) + X] =
+                    (CharRow[Y] & (0b10000000 >> X)) ? 0xFFFFFFFF : 0;
+            }
+        }
+    }
+    GlyphMasksReady = 1;
+}
 
-    if (CellX < 0 ||
-        CellY < 0 ||
-        CellX > MaxCellX ||
-        CellY > MaxCellY) {
-        return;
+internal glyph_atlas*
+GlyphAtlasGet(u32 Foreground, u32 Background) {
+    GlyphAtlasUseCount++;
+    glyph_atlas* Last = GlyphAtlasLast;
+    if (Last && Last->Foreground == Foreground && Last->Background == Background) {
+        Last->LastUse = GlyphAtlasUseCount;
+        return Last;
+    }
+
+    glyph_atlas* Oldest = GlyphAtlases;
+    for (i32 Index = 0; Index < GlyphAtlasCacheCount; Index++) {
+        glyph_atlas* Atlas = GlyphAtlases + Index;
+        if (Atlas->Valid && Atlas->Foreground == Foreground && Atlas->Background == Background) {
+            Atlas->LastUse = GlyphAtlasUseCount;
+            GlyphAtlasLast = Atlas;
+            return Atlas;
+        }
+        if (!Atlas->Valid || (Oldest->Valid && Atlas->LastUse < Oldest->LastUse)) {
+            Oldest = Atlas;
+        }
     }
 
-    u8* CharRow = EmbeddedFont;
+    if (!GlyphMasksReady) {
+        GlyphMasksBuild();
+    }
+    u32* Mask = &GlyphMasks[0][0];
+    u32* Pixel = &Oldest->Pixels[0][0];
+    for (i32 Index = 0; Index < GlyphCount * GlyphPixelCount; Index++) {
+        Pixel[Index] = (Mask[Index] & Foreground) | (~Mask[Index] & Background);
+    }
+    Oldest->Valid = 1;
+    Oldest->Foreground = Foreground;
+    Oldest->Background = Background;
+    Oldest->LastUse = GlyphAtlasUseCount;
+    GlyphAtlasLast = Oldest;
+    return Oldest;
+}
 
-    CharRow += (EmbeddedFontWidth * Char);
+// NOTE: Draws Text from cell (CellX, CellY) on, background included, so it
+//       replaces what was there. Clipped to Dest per pixel, characters
+//       partly outside are drawn in part.
+internal void
+DrawText(pixel_buffer* Dest, i32 CellX, i32 CellY, u8* Text, u32 Foreground, u32 Background) {
+    i32 Top = CellY * EmbeddedFontHeight;
+    i32 FirstRow = (Top < 0) ? -Top : 0;
+    i32 LastRow = Dest->Height - Top;
+    if (LastRow > EmbeddedFontHeight) {
+        LastRow = EmbeddedFontHeight;
+    }
+    if (FirstRow >= LastRow) {
+        return;
+    }
 
-    u32* DestRow = Dest->Memory;
+    glyph_atlas* Atlas = GlyphAtlasGet(Foreground, Background);
+    i32 Left = CellX * EmbeddedFontWidth;
+    for (u8* Char = Text; *Char; Char++, Left += EmbeddedFontWidth) {
+        if (Left >= Dest->Width) {
+            break;
+        }
+        if (Left + EmbeddedFontWidth <= 0) {
+            continue;
+        }
 
-    DestRow += (CellY * EmbeddedFontHeight * Dest->Width);
-    DestRow += (CellX * EmbeddedFontWidth);
+        i32 FirstColumn = (Left < 0) ? -Left : 0;
+        i32 ColumnCount = Dest->Width - Left;
+        if (ColumnCount > EmbeddedFontWidth) {
+            ColumnCount = EmbeddedFontWidth;
+        }
+        ColumnCount -= FirstColumn;
 
-    for (i32 CharPixelY = 0; CharPixelY < EmbeddedFontHeight; CharPixelY++) {
-        u32* DestPixel = DestRow;
-        for (i32 CharPixelX = 0; CharPixelX < EmbeddedFontWidth; CharPixelX++) {
-            u8 CharPixelvalue = *CharRow & (0b10000000 >> CharPixelX);
-            if (CharPixelvalue) {
-                *DestPixel = 0xFFFFFFFF;
+        u32* Source = Atlas->Pixels[*Char] + (FirstRow * EmbeddedFontWidth) + FirstColumn;
+        u32* DestRow = Dest->Memory + ((Top + FirstRow) * Dest->Width) + Left + FirstColumn;
+        if (ColumnCount == EmbeddedFontWidth) {
+            for (i32 Row = FirstRow; Row < LastRow; Row++) {
+                memcpy(DestRow, Source, sizeof(u32) * EmbeddedFontWidth);
+                Source += EmbeddedFontWidth;
+                DestRow += Dest->Width;
+            }
+        } else {
+            for (i32 Row = FirstRow; Row < LastRow; Row++) {
+                memcpy(DestRow, Source, sizeof(u32) * ColumnCount);
+                Source += EmbeddedFontWidth;
+                DestRow += Dest->Width;
             }
-            DestPixel++;
         }
-
-        CharRow++;
-        DestRow += Dest->Width;
     }
 }
 
+internal void
+PutCharOpaque(pixel_buffer* Dest, i32 CellX, i32 CellY, u8 Char, u32 Foreground, u32 Background) {
+    u8 Text[2] = {Char, 0};
+    DrawText(Dest, CellX, CellY, Text, Foreground, Background);
+}
+
+// NOTE: Default colours, the debug screen is cleared to TextBackground
+internal void
+PutChar(pixel_buffer* Dest, i32 CellX, i32 CellY, u8 Char) {
+    PutCharOpaque(Dest, CellX, CellY, Char, TextForeground, TextBackground);
+}
+
 internal void
 PrintToPixelBuffer(pixel_buffer* Dest, i32 CellX, i32 CellY, u8* Text) {
-    u8* CurrentChar = Text;
-    i32 TextOffset = 0;
-    while (*CurrentChar != 0) {
-        PutChar(Dest, CellX + TextOffset, CellY, *CurrentChar);
-        CurrentChar++;
-        TextOffset++;
-    }
+    DrawText(Dest, CellX, CellY, Text, TextForeground, TextBackground);
 }
 
 #endif
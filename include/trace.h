@@ -0,0 +1,88 @@
+#ifndef _EMU_TRACE_H
+#define _EMU_TRACE_H
+
+#include "base.h"
+#include "emu_types.h"
+#include "bus.h"
+
+#include "m6502.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// NOTE: Trace file is this header followed by raw trace_record's, formatting
+//       to text is done offline by trace_dump (src/trace_dump.c)
+#define TraceFileMagic   (0x4352544E)
+#define TraceFileVersion (1)
+
+typedef struct trace_file_header {
+    u32 Magic;
+    u16 Version;
+    u16 RecordSize;
+} trace_file_header;
+
+internal void
+TraceInit(trace_buffer* Trace, trace_record* Records, u32 Capacity, FILE* Stream) {
+    Assert(Capacity && !(Capacity & (Capacity - 1)));
+    memset(Records, 0, sizeof(trace_record) * Capacity);
+    Trace->Records = Records;
+    Trace->Mask = Capacity - 1;
+    Trace->Count = 0;
+    Trace->FlushedCount = 0;
+    Trace->Stream = Stream;
+
+    if (Stream) {
+        trace_file_header Header = {0};
+        Header.Magic = TraceFileMagic;
+        Header.Version = TraceFileVersion;
+        Header.RecordSize = sizeof(trace_record);
+        fwrite(&Header, sizeof(Header), 1, Stream);
+    }
+}
+
+internal void
+TraceFlush(trace_buffer* Trace) {
+    // NOTE: Records since the last flush never wrap, the ring is flushed
+    //       only when it is full or at the end
+    if (Trace->Stream) {
+        u64 PendingCount = Trace->Count - Trace->FlushedCount;
+        fwrite(Trace->Records + (Trace->FlushedCount & Trace->Mask),
+               sizeof(trace_record), (size_t)PendingCount, Trace->Stream);
+        Trace->FlushedCount = Trace->Count;
+    }
+}
+
+// NOTE: Called by the CPU cores right before the opcode fetch at PC. The
+//       ring is written out before it would overwrite unflushed records,
+//       not right when it fills up, so TraceDropLast always works.
+internal void
+TraceInstruction(trace_buffer* Trace, bus* Bus, m6502_t* Cpu, u16 PC) {
+    if (Trace->Stream && (Trace->Count - Trace->FlushedCount) > Trace->Mask) {
+        TraceFlush(Trace);
+    }
+
+    trace_record* Record = Trace->Records + (Trace->Count & Trace->Mask);
+    Record->MasterClock = Bus->Scheduler.MasterClock;
+    Record->PC = PC;
+    Record->OpCode = BusPeek(Bus, PC);
+    Record->Operand[0] = BusPeek(Bus, PC + 1);
+    Record->Operand[1] = BusPeek(Bus, PC + 2);
+    Record->A = Cpu->A;
+    Record->X = Cpu->X;
+    Record->Y = Cpu->Y;
+    Record->S = Cpu->S;
+    Record->P = Cpu->P;
+
+    Trace->Count++;
+}
+
+// NOTE: For an opcode fetch an interrupt took over (accurate core only knows
+//       on the cycle after the fetch)
+internal void
+TraceDropLast(trace_buffer* Trace) {
+    if (Trace->Count > Trace->FlushedCount) {
+        Trace->Count--;
+    }
+}
+
+#endif
@@ -0,0 +1,1134 @@
+#include "base.h"
+
+#define CHIPS_IMPL
+#include "m6502.h"
+
+#include "bus.h"
+#include "rom.h"
+#include "disassembly.h"
+#include "gfx.h"
+#include "arena.h"
+#include "file_io.h"
+#include "emulator.h"
+#include "save_state.h"
+#include "rewind.h"
+#include "run_ahead.h"
+#include "battery_save.h"
+#include "profiler.h"
+#include "debug_view.h"
+
+#define APP_IMPLEMENTATION
+#define APP_NULL
+#include "app.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// NOTE: Headless entry point. No window and no debug panels (unless benchmarking
+//       them with -debugdraw), just GlobalFrame as fast as the host allows.
+//       Results go to stdout, PlatformPrint goes to stderr so the output stays
+//       easy to parse.
+
+void
+PlatformPrint(char* FormatString, ...) {
+    char FormatBuffer[Kilobytes(1)];
+    va_list Arguments;
+    va_start(Arguments, FormatString);
+    vsprintf(FormatBuffer, FormatString, Arguments);
+    va_end(Arguments);
+    fprintf(stderr, "PLATFORM: %s\n", FormatBuffer);
+}
+
+u64
+PlatformTimeNanoseconds(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Counter;
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Counter);
+    return (u64)((f64)Counter.QuadPart * (1000000000.0 / (f64)Frequency.QuadPart));
+#else
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return ((u64)Time.tv_sec * 1000000000ULL) + (u64)Time.tv_nsec;
+#endif
+}
+
+#define DefaultFrameCount (600)
+#define MaxRomCount (64)
+#define TraceRecordCount (1 << 16)
+#define StateBenchmarkIterations (10000)
+
+typedef struct headless_options {
+    char* RomPaths[MaxRomCount];
+    i32 RomCount;
+    i32 FrameCount;
+    char* ScreenshotPath;
+    char* OutputPath;
+    char* TracePath;
+    char* LoadStatePath;
+    char* SaveStatePath;
+    char* RomDatabasePath;
+    i32 RewindFrameCount;
+    bool32 Rewind;
+    i32 RunAheadFrameCount;
+    bool32 Battery;
+    bool32 PrintState;
+    bool32 Benchmark;
+    bool32 DebugDraw;
+    bool32 DebugSync;
+    bool32 KernelBenchmark;
+    bool32 CoreCheck;
+    cpu_core CpuCore;
+} headless_options;
+
+internal void
+PrintUsage(char* ProgramName) {
+    fprintf(stderr,
+            "Usage: %s <rom.nes> [-frames N] [-core fast|accurate] [-screenshot out.ppm] [-state] [-trace trace.bin]\n"
+            "                    [-loadstate in.state] [-savestate out.state] [-rewind N]\n"
+            "                    [-runahead N] [-romdb database.txt] [-battery]\n"
+            "       %s -bench <rom.nes>... [-frames N] [-core fast|accurate] [-debugdraw|-debugsync] [-trace trace.bin] [-runahead N]\n"
+            "                    [-out results.jsonl]\n"
+            "       %s -kernelbench [-out results.jsonl]\n"
+            "       %s -corecheck\n"
+            "  -frames N          Number of frames to emulate per ROM (default: %d)\n"
+            "  -core NAME         CPU core: accurate (cycle-stepped, default) or fast\n"
+            "  -screenshot FILE   Write the last NES frame as binary PPM\n"
+            "  -state             Print CPU and PPU state after the run\n"
+            "  -trace FILE        Record every executed instruction to FILE (see trace_dump)\n"
+            "  -loadstate FILE    Start from a save state instead of power on\n"
+            "  -savestate FILE    Write a save state after the last frame\n"
+            "  -rewind N          Capture rewind states every frame, step N frames back at the end\n"
+            "  -runahead N        Draw every frame N frames ahead of the machine (at most %d)\n"
+            "  -romdb FILE        Add ROM database entries from FILE (see rom_database.h),\n"
+            "                     needed for header fixes, none are built in\n"
+            "  -battery           Keep battery PRG-RAM in a .sav file next to the ROM\n"
+            "  -bench             Benchmark every given ROM, one JSON object per line\n"
+            "  -debugdraw         Also compose the debug panels, each at its own refresh rate\n"
+            "  -debugsync         Like -debugdraw, but refresh every panel every frame\n"
+            "  -kernelbench       Time every pixel, pixel buffer and CRC-32 kernel variant the CPU supports against scalar\n"
+            "  -corecheck         Run the built-in CPU core checks on both cores, exit code 1 on a failure\n"
+            "  -out FILE          Append benchmark results to FILE instead of stdout\n",
+            ProgramName, ProgramName, ProgramName, ProgramName, DefaultFrameCount, RunAheadMaxFrameCount);
+}
+
+internal bool32
+ParseOptions(i32 ArgumentCount, char** Arguments, headless_options* Options) {
+    memset(Options, 0, sizeof(*Options));
+    Options->FrameCount = DefaultFrameCount;
+
+    for (i32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ArgumentIndex++) {
+        char* Argument = Arguments[ArgumentIndex];
+        bool32 HasValue = (ArgumentIndex + 1) < ArgumentCount;
+        if (strcmp(Argument, "-frames") == 0 && HasValue) {
+            Options->FrameCount = atoi(Arguments[++ArgumentIndex]);
+        } else if (strcmp(Argument, "-screenshot") == 0 && HasValue) {
+            Options->ScreenshotPath = Arguments[++ArgumentIndex];
+        } else if (strcmp(Argument, "-core") == 0 && HasValue) {
+            char* CoreName = Arguments[++ArgumentIndex];
+            if (strcmp(CoreName, "fast") == 0) {
+                Options->CpuCore = CpuCoreFast;
+            } else if (strcmp(CoreName, "accurate") == 0) {
+                Options->CpuCore = CpuCoreAccurate;
+            } else {
+                return 0;
+            }
+        } else if (strcmp(Argument, "-trace") == 0 && HasValue) {
+            Options->TracePath = Arguments[++ArgumentIndex];
+        } else if (strcmp(Argument, "-loadstate") == 0 && HasValue) {
+            Options->LoadStatePath = Arguments[++ArgumentIndex];
+        } else if (strcmp(Argument, "-savestate") == 0 && HasValue) {
+            Options->SaveStatePath = Arguments[++ArgumentIndex];
+        } else if (strcmp(Argument, "-rewind") == 0 && HasValue) {
+            Options->Rewind = 1;
+            Options->RewindFrameCount = atoi(Arguments[++ArgumentIndex]);
+        } else if (strcmp(Argument, "-runahead") == 0 && HasValue) {
+            Options->RunAheadFrameCount = atoi(Arguments[++ArgumentIndex]);
+        } else if (strcmp(Argument, "-romdb") == 0 && HasValue) {
+            Options->RomDatabasePath = Arguments[++ArgumentIndex];
+        } else if (strcmp(Argument, "-out") == 0 && HasValue) {
+            Options->OutputPath = Arguments[++ArgumentIndex];
+        } else if (strcmp(Argument, "-battery") == 0) {
+            Options->Battery = 1;
+        } else if (strcmp(Argument, "-state") == 0) {
+            Options->PrintState = 1;
+        } else if (strcmp(Argument, "-bench") == 0) {
+            Options->Benchmark = 1;
+        } else if (strcmp(Argument, "-kernelbench") == 0) {
+            Options->KernelBenchmark = 1;
+        } else if (strcmp(Argument, "-corecheck") == 0) {
+            Options->CoreCheck = 1;
+        } else if (strcmp(Argument, "-debugdraw") == 0) {
+            Options->DebugDraw = 1;
+        } else if (strcmp(Argument, "-debugsync") == 0) {
+            Options->DebugDraw = 1;
+            Options->DebugSync = 1;
+        } else if (Argument[0] != '-' && Options->RomCount < MaxRomCount) {
+            Options->RomPaths[Options->RomCount++] = Argument;
+        } else {
+            return 0;
+        }
+    }
+
+    if (Options->KernelBenchmark || Options->CoreCheck) {
+        return Options->RomCount == 0;
+    }
+
+    if (!Options->Benchmark && Options->RomCount > 1) {
+        return 0;
+    }
+
+    return Options->RomCount > 0 && Options->FrameCount > 0;
+}
+
+internal bool32
+SaveScreenshot(char* FileName, pixel_buffer* Buffer, memory_arena* Arena) {
+    // NOTE: Binary PPM (P6), pixels are stored as xbgr like app_present expects
+    char Header[32];
+    i32 HeaderSize = sprintf(Header, "P6\n%d %d\n255\n", Buffer->Width, Buffer->Height);
+    size_t PixelDataSize = (size_t)Buffer->Width * Buffer->Height * 3;
+
+    arena_mark Mark = ArenaMark(Arena);
+    u8* FileData = ArenaPushArray(Arena, u8, HeaderSize + PixelDataSize);
+    memcpy(FileData, Header, HeaderSize);
+
+    u8* Destination = FileData + HeaderSize;
+    for (i32 PixelIndex = 0; PixelIndex < Buffer->Width * Buffer->Height; PixelIndex++) {
+        u32 Color = Buffer->Memory[PixelIndex];
+        *Destination++ = (u8)(Color >> 0);
+        *Destination++ = (u8)(Color >> 8);
+        *Destination++ = (u8)(Color >> 16);
+    }
+
+    bool32 Result = SaveFile(FileName, FileData, HeaderSize + PixelDataSize);
+    ArenaReset(Arena, Mark);
+    return Result;
+}
+
+typedef struct run_result {
+    bool32 Loaded;
+    u64 RomLoadNanoseconds;
+    u32 RomCrc32;
+    u32 RomMapperId;
+    bool32 RomNes20;
+    bool32 RomInDatabase;
+    size_t ArenaHighWater;
+    size_t ScratchFrameHighWater;
+    u64 TickCount;
+    u64 Nanoseconds;
+    u64 Counter;
+    f64 StateSaveNanoseconds;
+    f64 StateLoadNanoseconds;
+    u32 RewindFrames;
+    u32 RewindBytes;
+    f64 RewindBytesPerFrame;
+    f64 RewindCaptureNanoseconds;
+    i32 RunAheadFrameCount;
+    f64 RunAheadNanoseconds;
+} run_result;
+
+internal run_result
+RunRom(char* RomPath, headless_options* Options) {
+    run_result Result = {0};
+
+    u64 LoadStart = PlatformTimeNanoseconds();
+    loaded_file RomFile = MapFile(RomPath);
+    rom Rom;
+    if (!ParseRom(RomFile, &Rom)) {
+        fprintf(stderr, "Can't load ROM '%s'\n", RomPath);
+        UnmapFile(&RomFile);
+        return Result;
+    }
+    Result.Loaded = 1;
+    Result.RomLoadNanoseconds = PlatformTimeNanoseconds() - LoadStart;
+    Result.RomCrc32 = Rom.Crc32;
+    Result.RomMapperId = Rom.MapperId;
+    Result.RomNes20 = Rom.Nes20;
+    Result.RomInDatabase = Rom.InDatabase;
+
+    memory_arena Arena = ArenaInit(Megabytes(32));
+    machine_state* Machine = ArenaPushStruct(&Arena, machine_state);
+    chr_cache* ChrCache = ArenaPushStruct(&Arena, chr_cache);
+    ChrCacheInit(ChrCache);
+    bus Bus = {0};
+    MachineInit(Machine, &Bus, &Rom);
+    Bus.ChrCache = ChrCache;
+    battery_save Battery = {0};
+    if (Options->Battery && !BatterySaveOpen(&Battery, RomPath, &Bus)) {
+        fprintf(stderr, "Can't map the .sav file of '%s', PRG-RAM won't be kept\n", RomPath);
+    }
+    BusMapMemory(&Bus);
+
+    m6502_t* Cpu = &Machine->Cpu;
+    ppu* Ppu = &Machine->Ppu;
+
+    pixel_buffer NesScreen = {
+        NesScreenWidth,
+        NesScreenHeight,
+        ArenaPushArray(&Arena, u32, NesScreenWidth * NesScreenHeight),
+    };
+
+    Bus.Screen = &NesScreen;
+    SchedulerInit(&Bus);
+    Bus.Scheduler.CpuCore = Options->CpuCore;
+    if (Options->CpuCore == CpuCoreFast) {
+        FastCpuReset(Cpu, &Bus);
+    }
+    if (Options->LoadStatePath && !SaveStateLoadFile(Options->LoadStatePath, Machine, &Bus)) {
+        fprintf(stderr, "Can't load save state '%s'\n", Options->LoadStatePath);
+    }
+
+    memory_arena Scratch = {0};
+    disassembler* Disassembler = 0;
+    pixel_buffer Screen = {0};
+    debug_views* Views = 0;
+    if (Options->DebugDraw) {
+        instruction_info* Instructions = ArenaPushArray(&Arena, instruction_info, 0x100);
+        Scratch = ArenaInit(Megabytes(1));
+        Bus.CodeDataLog = ArenaPushArray(&Arena, u8, CodeDataLogSize(Bus.Rom));
+        Disassembler = ArenaPushStruct(&Arena, disassembler);
+
+        memset(Instructions, 0, sizeof(instruction_info) * 0x100);
+        memset(Bus.CodeDataLog, 0, CodeDataLogSize(Bus.Rom));
+        InitInstructionsDictionary(Instructions);
+        DisassemblerInit(Disassembler, &Bus, Instructions);
+
+        Screen.Width = DebugViewWidth;
+        Screen.Height = DebugViewHeight;
+        Screen.Memory = ArenaPushArray(&Arena, u32, DebugViewWidth * DebugViewHeight);
+
+        Views = ArenaPushStruct(&Arena, debug_views);
+        DebugViewsInit(Views, &Arena);
+    }
+
+    trace_buffer Trace = {0};
+    FILE* TraceFile = 0;
+    if (Options->TracePath) {
+        TraceFile = fopen(Options->TracePath, "wb");
+        if (TraceFile) {
+            trace_record* Records = ArenaPushArray(&Arena, trace_record, TraceRecordCount);
+            TraceInit(&Trace, Records, TraceRecordCount, TraceFile);
+            Bus.Trace = &Trace;
+        } else {
+            fprintf(stderr, "Can't write trace to '%s'\n", Options->TracePath);
+        }
+    }
+
+    rewind_buffer Rewind = {0};
+    if (Options->Rewind) {
+        RewindInit(&Rewind, &Arena,
+                   RewindDefaultArenaSize, RewindDefaultEntryCount, RewindDefaultKeyframeInterval);
+    }
+
+    run_ahead RunAhead;
+    RunAheadInit(&RunAhead, &Arena, Options->RunAheadFrameCount);
+
+    ProfilerReset();
+
+    u64 RunStart = PlatformTimeNanoseconds();
+    u64 CounterStart = ProfilerReadCounter();
+    for (i32 Frame = 0; Frame < Options->FrameCount; Frame++) {
+        RunAheadFrame(&RunAhead, Machine, &Bus);
+        if (Options->DebugDraw) {
+            ArenaBeginFrame(&Scratch);
+            if (Options->DebugSync) {
+                DebugViewsInvalidate(Views);
+            }
+            DrawDebugView(&Screen, &NesScreen, Views,
+                          Cpu, &Bus,
+                          Disassembler,
+                          0.0f,
+                          PlatformTimeNanoseconds(),
+                          &Scratch);
+        }
+        if (Options->Rewind) {
+            RewindCapture(&Rewind, Machine, &Bus);
+        }
+        BatterySaveUpdate(&Battery);
+    }
+    u64 CounterEnd = ProfilerReadCounter();
+    u64 RunEnd = PlatformTimeNanoseconds();
+
+    Result.TickCount = Bus.Scheduler.MasterClock;
+    Result.Nanoseconds = RunEnd - RunStart;
+    Result.Counter = CounterEnd - CounterStart;
+
+    if (TraceFile) {
+        TraceFlush(&Trace);
+        fclose(TraceFile);
+    }
+
+    Result.RunAheadFrameCount = RunAhead.FrameCount;
+    Result.RunAheadNanoseconds = RunAhead.RunCount ?
+        (f64)RunAhead.ExtraNanoseconds / (f64)RunAhead.RunCount : 0.0;
+
+    Result.RewindFrames = Rewind.EntryCount;
+    Result.RewindBytes = Rewind.UsedBytes;
+    Result.RewindCaptureNanoseconds = Rewind.CaptureCount ?
+        (f64)Rewind.CaptureNanoseconds / (f64)Rewind.CaptureCount : 0.0;
+    Result.RewindBytesPerFrame = Rewind.CaptureCount ?
+        (f64)Rewind.CapturedBytes / (f64)Rewind.CaptureCount : 0.0;
+    for (i32 Step = 0; Step < Options->RewindFrameCount; Step++) {
+        if (!RewindStep(&Rewind, Machine, &Bus)) {
+            fprintf(stderr, "Rewind stopped after %d frames\n", Step);
+            break;
+        }
+    }
+
+    save_state* Slot = ArenaPushStruct(&Arena, save_state);
+    Result.StateSaveNanoseconds = 0.0;
+    Result.StateLoadNanoseconds = 0.0;
+    if (Options->Benchmark) {
+        // NOTE: Round trips leave the machine as it was, screenshot and
+        //       state below don't change
+        u64 SaveNanoseconds = 0;
+        u64 LoadNanoseconds = 0;
+        for (i32 Iteration = 0; Iteration < StateBenchmarkIterations; Iteration++) {
+            u64 Start = PlatformTimeNanoseconds();
+            SaveStateCapture(Slot, Machine, &Bus);
+            u64 Middle = PlatformTimeNanoseconds();
+            SaveStateRestore(Slot, Machine, &Bus);
+            u64 End = PlatformTimeNanoseconds();
+            SaveNanoseconds += Middle - Start;
+            LoadNanoseconds += End - Middle;
+        }
+        Result.StateSaveNanoseconds = (f64)SaveNanoseconds / StateBenchmarkIterations;
+        Result.StateLoadNanoseconds = (f64)LoadNanoseconds / StateBenchmarkIterations;
+    }
+
+    if (Options->SaveStatePath) {
+        SaveStateCapture(Slot, Machine, &Bus);
+        if (!SaveStateWriteFile(Options->SaveStatePath, Slot)) {
+            fprintf(stderr, "Can't write save state to '%s'\n", Options->SaveStatePath);
+        }
+    }
+
+    if (Options->PrintState) {
+        printf("PC:%04X A:%02X X:%02X Y:%02X S:%02X P:%02X\n",
+               Cpu->PC, Cpu->A, Cpu->X, Cpu->Y, Cpu->S, Cpu->P);
+        printf("S: %04d, D: %03d, CTRL: %02X, STATUS: %02X\n",
+               Ppu->Scanline, Ppu->Dot,
+               Ppu->Control,
+               PpuPackStatus(Ppu));
+    }
+
+    if (Options->ScreenshotPath) {
+        if (!SaveScreenshot(Options->ScreenshotPath, &NesScreen, &Arena)) {
+            fprintf(stderr, "Can't write screenshot to '%s'\n", Options->ScreenshotPath);
+        }
+    }
+
+    BatterySaveClose(&Battery, Machine, &Bus);
+    arena_stats ArenaStats = ArenaGetStats(&Arena);
+    arena_stats ScratchStats = ArenaGetStats(&Scratch);
+    Result.ArenaHighWater = ArenaStats.HighWater;
+    Result.ScratchFrameHighWater = ScratchStats.FrameHighWater;
+    ArenaFree(&Scratch);
+    ArenaFree(&Arena);
+    UnmapFile(&RomFile);
+
+    return Result;
+}
+
+internal void
+WriteBenchmarkResult(FILE* Output, char* RomPath, i32 FrameCount,
+                     bool32 DebugDraw, bool32 Trace, bool32 Rewind,
+                     cpu_core CpuCore, run_result* Result) {
+    f64 Seconds = (f64)Result->Nanoseconds / 1000000000.0;
+    f64 FramesPerSecond = (Seconds > 0.0) ? (f64)FrameCount / Seconds : 0.0;
+    f64 NanosecondsPerTick = (Result->TickCount) ? (f64)Result->Nanoseconds / (f64)Result->TickCount : 0.0;
+
+    fprintf(Output, "{\"rom\":\"");
+    for (char* Char = RomPath; *Char; Char++) {
+        if (*Char == '"' || *Char == '\\') {
+            fputc('\\', Output);
+        }
+        fputc(*Char, Output);
+    }
+    fprintf(Output, "\",\"frames\":%d,\"core\":\"%s\",\"debug_draw\":%s,\"trace\":%s,\"ticks\":%llu,\"seconds\":%.6f,"
+                    "\"fps\":%.2f,\"ns_per_tick\":%.3f,"
+                    "\"state_save_ns\":%.1f,\"state_load_ns\":%.1f,\"rom_load_ns\":%llu,",
+            FrameCount,
+            (CpuCore == CpuCoreFast) ? "fast" : "accurate",
+            DebugDraw ? "true" : "false",
+            Trace ? "true" : "false",
+            (unsigned long long)Result->TickCount,
+            Seconds,
+            FramesPerSecond,
+            NanosecondsPerTick,
+            Result->StateSaveNanoseconds,
+            Result->StateLoadNanoseconds,
+            (unsigned long long)Result->RomLoadNanoseconds);
+
+    fprintf(Output, "\"rom_crc32\":\"%08X\",\"rom_mapper\":%u,\"rom_nes20\":%s,\"rom_database\":%s,",
+            Result->RomCrc32,
+            Result->RomMapperId,
+            Result->RomNes20 ? "true" : "false",
+            Result->RomInDatabase ? "true" : "false");
+    fprintf(Output, "\"arena_high_water\":%llu,\"scratch_frame_high_water\":%llu,",
+            (unsigned long long)Result->ArenaHighWater,
+            (unsigned long long)Result->ScratchFrameHighWater);
+    fprintf(Output, "\"run_ahead\":%d,\"run_ahead_extra_ns\":%.1f,",
+            Result->RunAheadFrameCount,
+            Result->RunAheadNanoseconds);
+    if (Rewind) {
+        fprintf(Output, "\"rewind\":{\"frames\":%u,\"bytes\":%u,\"bytes_per_frame\":%.1f,\"capture_ns\":%.1f},",
+                Result->RewindFrames,
+                Result->RewindBytes,
+                Result->RewindBytesPerFrame,
+                Result->RewindCaptureNanoseconds);
+    } else {
+        fprintf(Output, "\"rewind\":null,");
+    }
+    fprintf(Output, "\"profile\":");
+
+#if PROFILE
+    // NOTE: Counter runs at its own rate (rdtsc), share is relative to the whole run
+    f64 TotalCounter = (f64)Result->Counter;
+    fprintf(Output, "{");
+    for (i32 BlockIndex = 0; BlockIndex < ProfileBlock_Count; BlockIndex++) {
+        profile_block* Block = GlobalProfileBlocks + BlockIndex;
+        f64 Share = (TotalCounter > 0.0) ? (f64)Block->Counter / TotalCounter : 0.0;
+        fprintf(Output, "%s\"%s\":{\"share\":%.4f,\"hits\":%llu}",
+                BlockIndex ? "," : "",
+                ProfileBlockName((profile_block_id)BlockIndex),
+                Share,
+                (unsigned long long)Block->HitCount);
+    }
+    fprintf(Output, "}");
+#else
+    fprintf(Output, "null");
+#endif
+
+    fprintf(Output, "}\n");
+}
+
+#define KernelBenchmarkTileIterations (2000)
+#define KernelBenchmarkLineIterations (4000)
+#define KernelBenchmarkLineCount      (NesScreenHeight)
+#define KernelBenchmarkCrcSize        (Megabytes(1))
+#define KernelBenchmarkCrcIterations  (64)
+#define KernelBenchmarkFillIterations (200)
+#define KernelBenchmarkBlitIterations (200)
+
+internal void
+WriteKernelResult(FILE* Output, char* Kernel, char* Variant, bool32 Selected,
+                  f64 NanosecondsPerItem, f64 ScalarNanosecondsPerItem, bool32 Matches) {
+    fprintf(Output, "{\"kernel\":\"%s\",\"variant\":\"%s\",\"selected\":%s,"
+                    "\"ns_per_item\":%.4f,\"speedup\":%.2f,\"matches_scalar\":%s}\n",
+            Kernel, Variant,
+            Selected ? "true" : "false",
+            NanosecondsPerItem,
+            (NanosecondsPerItem > 0.0) ? ScalarNanosecondsPerItem / NanosecondsPerItem : 0.0,
+            Matches ? "true" : "false");
+}
+
+// NOTE: What the blits replaced, one pixel at a time, clipped the same way
+internal void
+ReferenceBlitScaled(pixel_buffer* Dest, pixel_buffer* Src, i32 X, i32 Y, i32 Scale) {
+    for (i32 DestY = 0; DestY < Dest->Height; DestY++) {
+        i32 SrcY = DestY - Y;
+        if (SrcY < 0 || SrcY >= Src->Height * Scale) {
+            continue;
+        }
+        u32* DestPixel = Dest->Memory + (DestY * Dest->Width);
+        u32* SrcRow = Src->Memory + ((SrcY / Scale) * Src->Width);
+        i32 Left = (X < 0) ? 0 : X;
+        i32 Right = (X + (Src->Width * Scale) > Dest->Width) ? Dest->Width : X + (Src->Width * Scale);
+        for (i32 DestX = Left; DestX < Right; DestX++) {
+            DestPixel[DestX] = SrcRow[(DestX - X) / Scale];
+        }
+    }
+}
+
+// NOTE: Micro-benchmark for pixel_kernels.h, gfx.h and crc32.h. DecodeTile
+//       items are tiles, Crc32 items are bytes, everything else is pixels
+//       written. Input is random, every variant's output is compared against
+//       the scalar kernel, blits against ReferenceBlitScaled.
+internal void
+RunKernelBenchmark(FILE* Output) {
+    memory_arena Arena = ArenaInit(Megabytes(16));
+    u8* Chr = ArenaPushArray(&Arena, u8, ChrTileCount * PatternSizeInBytes);
+    u8* Reference = ArenaPushArray(&Arena, u8, ChrTileCount * ChrTilePixelCount);
+    u8* Decoded = ArenaPushArray(&Arena, u8, ChrTileCount * ChrTilePixelCount);
+    u8* Indices = ArenaPushArray(&Arena, u8, KernelBenchmarkLineCount * NesScreenWidth);
+    u32* ReferencePixels = ArenaPushArray(&Arena, u32, KernelBenchmarkLineCount * NesScreenWidth);
+    u32* Pixels = ArenaPushArray(&Arena, u32, KernelBenchmarkLineCount * NesScreenWidth);
+    u8* CrcData = ArenaPushArray(&Arena, u8, KernelBenchmarkCrcSize);
+    u32* ReferenceScreen = ArenaPushArray(&Arena, u32, DebugViewWidth * DebugViewHeight);
+    u32* Screen = ArenaPushArray(&Arena, u32, DebugViewWidth * DebugViewHeight);
+    u32 Colors[32];
+
+    u32 Random = 0x12345678;
+    for (i32 ByteIndex = 0; ByteIndex < ChrTileCount * PatternSizeInBytes; ByteIndex++) {
+        Random = (Random * 1664525) + 1013904223;
+        Chr[ByteIndex] = (u8)(Random >> 24);
+    }
+    for (i32 PixelIndex = 0; PixelIndex < KernelBenchmarkLineCount * NesScreenWidth; PixelIndex++) {
+        Random = (Random * 1664525) + 1013904223;
+        Indices[PixelIndex] = (u8)(Random >> 27);
+    }
+    for (u32 ByteIndex = 0; ByteIndex < KernelBenchmarkCrcSize; ByteIndex++) {
+        Random = (Random * 1664525) + 1013904223;
+        CrcData[ByteIndex] = (u8)(Random >> 24);
+    }
+    for (i32 ColorIndex = 0; ColorIndex < 32; ColorIndex++) {
+        Colors[ColorIndex] = NesColors[(ColorIndex * 7) & 63];
+    }
+
+    for (i32 TileIndex = 0; TileIndex < ChrTileCount; TileIndex++) {
+        DecodeTileScalar(Reference + (TileIndex * ChrTilePixelCount), Chr + (TileIndex * PatternSizeInBytes));
+    }
+    for (i32 Line = 0; Line < KernelBenchmarkLineCount; Line++) {
+        ExpandIndicesScalar(ReferencePixels + (Line * NesScreenWidth), Indices + (Line * NesScreenWidth),
+                            Colors, NesScreenWidth);
+    }
+
+    f64 ScalarNanoseconds = 0.0;
+    for (u32 VariantIndex = 0; VariantIndex < ArrayCount(TileDecodeVariants); VariantIndex++) {
+        tile_decode_variant* Variant = TileDecodeVariants + VariantIndex;
+        if (!KernelVariantSupported(Variant->Features)) {
+            continue;
+        }
+        memset(Decoded, 0, ChrTileCount * ChrTilePixelCount);
+        u64 Start = PlatformTimeNanoseconds();
+        for (i32 Iteration = 0; Iteration < KernelBenchmarkTileIterations; Iteration++) {
+            for (i32 TileIndex = 0; TileIndex < ChrTileCount; TileIndex++) {
+                Variant->Kernel(Decoded + (TileIndex * ChrTilePixelCount), Chr + (TileIndex * PatternSizeInBytes));
+            }
+        }
+        u64 End = PlatformTimeNanoseconds();
+        f64 Nanoseconds = (f64)(End - Start) / ((f64)KernelBenchmarkTileIterations * ChrTileCount);
+        if (VariantIndex == 0) {
+            ScalarNanoseconds = Nanoseconds;
+        }
+        bool32 Matches = memcmp(Decoded, Reference, ChrTileCount * ChrTilePixelCount) == 0;
+        WriteKernelResult(Output, "DecodeTile", Variant->Name, Variant->Kernel == DecodeTile,
+                          Nanoseconds, ScalarNanoseconds, Matches);
+    }
+
+    for (u32 VariantIndex = 0; VariantIndex < ArrayCount(IndexExpandVariants); VariantIndex++) {
+        index_expand_variant* Variant = IndexExpandVariants + VariantIndex;
+        if (!KernelVariantSupported(Variant->Features)) {
+            continue;
+        }
+        // NOTE: Odd widths so the scalar tails get checked too
+        bool32 Matches = 1;
+        for (i32 Line = 0; Line < KernelBenchmarkLineCount; Line++) {
+            i32 Width = NesScreenWidth - (Line & 0b111);
+            memset(Pixels, 0, sizeof(u32) * NesScreenWidth);
+            Variant->Kernel(Pixels, Indices + (Line * NesScreenWidth), Colors, Width);
+            if (memcmp(Pixels, ReferencePixels + (Line * NesScreenWidth), sizeof(u32) * Width) != 0 ||
+                (Width < NesScreenWidth && Pixels[Width] != 0)) {
+                Matches = 0;
+            }
+        }
+
+        u64 Start = PlatformTimeNanoseconds();
+        for (i32 Iteration = 0; Iteration < KernelBenchmarkLineIterations; Iteration++) {
+            i32 Line = Iteration % KernelBenchmarkLineCount;
+            Variant->Kernel(Pixels + (Line * NesScreenWidth), Indices + (Line * NesScreenWidth), Colors, NesScreenWidth);
+        }
+        u64 End = PlatformTimeNanoseconds();
+        f64 Nanoseconds = (f64)(End - Start) / ((f64)KernelBenchmarkLineIterations * NesScreenWidth);
+        if (VariantIndex == 0) {
+            ScalarNanoseconds = Nanoseconds;
+        }
+        WriteKernelResult(Output, "ExpandIndices", Variant->Name, Variant->Kernel == ExpandIndices,
+                          Nanoseconds, ScalarNanoseconds, Matches);
+    }
+
+    for (u32 VariantIndex = 0; VariantIndex < ArrayCount(Crc32Variants); VariantIndex++) {
+        crc32_variant* Variant = Crc32Variants + VariantIndex;
+        if (!KernelVariantSupported(Variant->Features)) {
+            continue;
+        }
+        // NOTE: Odd offsets and sizes so the scalar heads and tails get checked too
+        bool32 Matches = 1;
+        for (u32 Size = 0; Size < 4096; Size += 61) {
+            u32 Offset = Size & 0b1111;
+            if (Variant->Kernel(0xFFFFFFFF, CrcData + Offset, Size) !=
+                Crc32UpdateScalar(0xFFFFFFFF, CrcData + Offset, Size)) {
+                Matches = 0;
+            }
+        }
+
+        u64 Start = PlatformTimeNanoseconds();
+        u32 State = 0xFFFFFFFF;
+        for (i32 Iteration = 0; Iteration < KernelBenchmarkCrcIterations; Iteration++) {
+            State = Variant->Kernel(State, CrcData, KernelBenchmarkCrcSize);
+        }
+        u64 End = PlatformTimeNanoseconds();
+        Unused(State);
+        f64 Nanoseconds = (f64)(End - Start) / ((f64)KernelBenchmarkCrcIterations * KernelBenchmarkCrcSize);
+        if (VariantIndex == 0) {
+            ScalarNanoseconds = Nanoseconds;
+        }
+        WriteKernelResult(Output, "Crc32", Variant->Name, Variant->Kernel == Crc32Update,
+                          Nanoseconds, ScalarNanoseconds, Matches);
+    }
+
+    i32 ScreenPixelCount = DebugViewWidth * DebugViewHeight;
+    for (u32 VariantIndex = 0; VariantIndex < ArrayCount(PixelFillVariants); VariantIndex++) {
+        pixel_fill_variant* Variant = PixelFillVariants + VariantIndex;
+        if (!KernelVariantSupported(Variant->Features)) {
+            continue;
+        }
+        bool32 Matches = 1;
+        for (i32 Count = 0; Count < 100; Count += 3) {
+            memset(Screen, 0, sizeof(u32) * 128);
+            Variant->Kernel(Screen + 1, 0xFF123456, Count);
+            for (i32 PixelIndex = 0; PixelIndex < 128; PixelIndex++) {
+                u32 Expected = (PixelIndex >= 1 && PixelIndex <= Count) ? 0xFF123456 : 0;
+                if (Screen[PixelIndex] != Expected) {
+                    Matches = 0;
+                }
+            }
+        }
+
+        u64 Start = PlatformTimeNanoseconds();
+        for (i32 Iteration = 0; Iteration < KernelBenchmarkFillIterations; Iteration++) {
+            Variant->Kernel(Screen, 0xFF000000 | (u32)Iteration, ScreenPixelCount);
+        }
+        u64 End = PlatformTimeNanoseconds();
+        f64 Nanoseconds = (f64)(End - Start) / ((f64)KernelBenchmarkFillIterations * ScreenPixelCount);
+        if (VariantIndex == 0) {
+            ScalarNanoseconds = Nanoseconds;
+        }
+        WriteKernelResult(Output, "FillPixels", Variant->Name, Variant->Kernel == FillPixels,
+                          Nanoseconds, ScalarNanoseconds, Matches);
+    }
+
+    for (i32 Scale = 2; Scale <= 3; Scale++) {
+        char* KernelName = (Scale == 2) ? "ScaleRow2x" : "ScaleRow3x";
+        for (u32 VariantIndex = 0; VariantIndex < ArrayCount(PixelScaleVariants); VariantIndex++) {
+            pixel_scale_variant* Variant = PixelScaleVariants + VariantIndex;
+            if (!KernelVariantSupported(Variant->Features)) {
+                continue;
+            }
+            // NOTE: Odd widths so the scalar tails get checked too
+            bool32 Matches = 1;
+            for (i32 Line = 0; Line < KernelBenchmarkLineCount; Line++) {
+                i32 Width = NesScreenWidth - (Line & 0b111);
+                u32* SrcRow = ReferencePixels + (Line * NesScreenWidth);
+                memset(Screen, 0, sizeof(u32) * NesScreenWidth * Scale);
+                ScaleRowScalar(ReferenceScreen, SrcRow, Width, Scale);
+                Variant->Kernel(Screen, SrcRow, Width, Scale);
+                if (memcmp(Screen, ReferenceScreen, sizeof(u32) * Width * Scale) != 0 ||
+                    (Width < NesScreenWidth && Screen[Width * Scale] != 0)) {
+                    Matches = 0;
+                }
+            }
+
+            u64 Start = PlatformTimeNanoseconds();
+            for (i32 Iteration = 0; Iteration < KernelBenchmarkLineIterations; Iteration++) {
+                i32 Line = Iteration % KernelBenchmarkLineCount;
+                Variant->Kernel(Screen + (Line * NesScreenWidth * Scale), ReferencePixels + (Line * NesScreenWidth),
+                                NesScreenWidth, Scale);
+            }
+            u64 End = PlatformTimeNanoseconds();
+            f64 Nanoseconds = (f64)(End - Start) / ((f64)KernelBenchmarkLineIterations * NesScreenWidth * Scale);
+            if (VariantIndex == 0) {
+                ScalarNanoseconds = Nanoseconds;
+            }
+            WriteKernelResult(Output, KernelName, Variant->Name, Variant->Kernel == ScaleRow,
+                              Nanoseconds, ScalarNanoseconds, Matches);
+        }
+    }
+
+    // NOTE: The NES frame onto the debug screen, once per pixel and with
+    //       PixelBufferBlitScaled. Positions cut every edge for the check.
+    pixel_buffer Frame = {NesScreenWidth, NesScreenHeight, ReferencePixels};
+    pixel_buffer ReferenceTarget = {DebugViewWidth, DebugViewHeight, ReferenceScreen};
+    pixel_buffer Target = {DebugViewWidth, DebugViewHeight, Screen};
+    i32 Positions[][2] = {
+        {0, 0}, {-37, -11}, {-1, 5}, {DebugViewWidth - 301, DebugViewHeight - 97},
+        {DebugViewWidth - 2, 3}, {-700, -500}, {5, DebugViewHeight - 1}, {DebugViewWidth, 0},
+    };
+    for (i32 Scale = 1; Scale <= 3; Scale++) {
+        char* KernelName = (Scale == 1) ? "PixelBufferBlit" :
+                           (Scale == 2) ? "PixelBufferBlitScaled2x" : "PixelBufferBlitScaled3x";
+        bool32 Matches = 1;
+        for (u32 PositionIndex = 0; PositionIndex < ArrayCount(Positions); PositionIndex++) {
+            i32 X = Positions[PositionIndex][0];
+            i32 Y = Positions[PositionIndex][1];
+            memset(ReferenceScreen, 0, sizeof(u32) * ScreenPixelCount);
+            memset(Screen, 0, sizeof(u32) * ScreenPixelCount);
+            ReferenceBlitScaled(&ReferenceTarget, &Frame, X, Y, Scale);
+            PixelBufferBlitScaled(&Target, &Frame, X, Y, Scale);
+            if (memcmp(Screen, ReferenceScreen, sizeof(u32) * ScreenPixelCount) != 0) {
+                Matches = 0;
+            }
+        }
+
+        i32 ItemCount = NesScreenWidth * NesScreenHeight * Scale * Scale;
+        u64 Start = PlatformTimeNanoseconds();
+        for (i32 Iteration = 0; Iteration < KernelBenchmarkBlitIterations; Iteration++) {
+            ReferenceBlitScaled(&ReferenceTarget, &Frame, 0, 0, Scale);
+        }
+        u64 End = PlatformTimeNanoseconds();
+        ScalarNanoseconds = (f64)(End - Start) / ((f64)KernelBenchmarkBlitIterations * ItemCount);
+        WriteKernelResult(Output, KernelName, "per_pixel", 0, ScalarNanoseconds, ScalarNanoseconds, 1);
+
+        Start = PlatformTimeNanoseconds();
+        for (i32 Iteration = 0; Iteration < KernelBenchmarkBlitIterations; Iteration++) {
+            PixelBufferBlitScaled(&Target, &Frame, 0, 0, Scale);
+        }
+        End = PlatformTimeNanoseconds();
+        f64 Nanoseconds = (f64)(End - Start) / ((f64)KernelBenchmarkBlitIterations * ItemCount);
+        WriteKernelResult(Output, KernelName, (Scale == 1) ? "memcpy" : ScaleRowName, 1,
+                          Nanoseconds, ScalarNanoseconds, Matches);
+    }
+
+    ArenaFree(&Arena);
+}
+
+// NOTE: Small programs that both CPU cores have to run to the same result as
+//       the hardware. They cover the dummy accesses that reach mappers and
+//       I/O: read-modify-write writing the old value back, and indexed modes
+//       reading the un-carried address, and when IRQs are taken after the I
+//       flag changes. Each runs from $C000 of an MMC1 or MMC3 ROM (4 16KB PRG
+//       banks, the first byte of bank N is $11 * (N + 1), $FFF0 is $FF, CHR
+//       RAM) after CoreCheckPrelude and ends in a JMP to itself. Results are
+//       stored from $0000.
+typedef struct core_check {
+    char* Name;
+    u32 MapperId;
+    u8* Code;
+    i32 CodeSize;
+    u8 Expected[4];
+    i32 ExpectedCount;
+} core_check;
+
+#define CoreCheckPrgBankCount (4)
+#define CoreCheckFrameCount   (8)
+
+// NOTE: SEI, CLD, stack, then two BIT $2002/BPL loops for the PPU to warm up
+global_variable u8 CoreCheckPrelude[] = {
+    0x78, 0xD8, 0xA2, 0xFF, 0x9A,
+    0x2C, 0x02, 0x20, 0x10, 0xFB,
+    0x2C, 0x02, 0x20, 0x10, 0xFB,
+};
+
+// NOTE: Four bits into the MMC1 PRG register, then INC on a ROM byte of $FF.
+//       The first of its two writes ($FF) resets the serial port, so no bank
+//       switch happens and bank 0 stays at $8000. The second write ($00)
+//       comes on the next cycle and is ignored, so five writes after it
+//       switch to bank 2.
+global_variable u8 CoreCheckMmc1Reset[] = {
+    0xA9, 0x01, 0x8D, 0x00, 0xE0,               // LDA #$01, STA $E000
+    0x4A,                                       // LSR A
+    0x8D, 0x00, 0xE0, 0x8D, 0x00, 0xE0,         // STA $E000 x3
+    0x8D, 0x00, 0xE0,
+    0xEE, 0xF0, 0xFF,                           // INC $FFF0
+    0xAD, 0x00, 0x80, 0x85, 0x00,               // LDA $8000, STA $00
+    0xA9, 0x00, 0x8D, 0x00, 0xE0,               // Bank 2: 0, 1, 0, 0, 0
+    0xA9, 0x01, 0x8D, 0x00, 0xE0,
+    0xA9, 0x00, 0x8D, 0x00, 0xE0, 0x8D, 0x00, 0xE0,
+    0x8D, 0x00, 0xE0,
+    0xAD, 0x00, 0x80, 0x85, 0x01,               // LDA $8000, STA $01
+};
+
+// NOTE: INC $2007 reads (address +1), writes the old value (+1) and the new
+//       one (+1). Palette bytes $01 $02 $03 $04 become $01 $01 $02 $04.
+//       Palette reads aren't buffered, so the bytes read are the bytes there.
+global_variable u8 CoreCheckPpuDataModify[] = {
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xA9, 0x01, 0x8D, 0x07, 0x20, 0xA9, 0x02, 0x8D, 0x07, 0x20,
+    0xA9, 0x03, 0x8D, 0x07, 0x20, 0xA9, 0x04, 0x8D, 0x07, 0x20,
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xEE, 0x07, 0x20,                           // INC $2007
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xAD, 0x07, 0x20, 0x85, 0x00, 0xAD, 0x07, 0x20, 0x85, 0x01,
+    0xAD, 0x07, 0x20, 0x85, 0x02, 0xAD, 0x07, 0x20, 0x85, 0x03,
+};
+
+// NOTE: STA $2000,X with X = 2 reads $2002 before writing it, which clears
+//       the PPUADDR latch between the two halves of $3F00
+global_variable u8 CoreCheckStoreAbsoluteX[] = {
+    0xA9, 0x21, 0x8D, 0x06, 0x20,               // first PPUADDR write
+    0xA2, 0x02, 0xA9, 0x3F, 0x9D, 0x00, 0x20,   // LDX #2, LDA #$3F, STA $2000,X
+    0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xA9, 0x2A, 0x8D, 0x07, 0x20,
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xAD, 0x07, 0x20, 0x85, 0x00,
+};
+
+// NOTE: Same with STA $2000,Y
+global_variable u8 CoreCheckStoreAbsoluteY[] = {
+    0xA9, 0x21, 0x8D, 0x06, 0x20,
+    0xA0, 0x02, 0xA9, 0x3F, 0x99, 0x00, 0x20,   // LDY #2, LDA #$3F, STA $2000,Y
+    0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xA9, 0x1A, 0x8D, 0x07, 0x20,
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xAD, 0x07, 0x20, 0x85, 0x00,
+};
+
+// NOTE: Same with STA ($10),Y, the pointer is $2000
+global_variable u8 CoreCheckStoreIndirectY[] = {
+    0xA9, 0x00, 0x85, 0x10, 0xA9, 0x20, 0x85, 0x11,
+    0xA9, 0x21, 0x8D, 0x06, 0x20,
+    0xA0, 0x02, 0xA9, 0x3F, 0x91, 0x10,         // LDY #2, LDA #$3F, STA ($10),Y
+    0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xA9, 0x16, 0x8D, 0x07, 0x20,
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xAD, 0x07, 0x20, 0x85, 0x00,
+};
+
+// NOTE: LDA $20FF,X with X = 8 crosses a page, the dummy read of $2007
+//       moves past palette byte $01 before the real read of $2107
+global_variable u8 CoreCheckLoadPageCross[] = {
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xA9, 0x01, 0x8D, 0x07, 0x20, 0xA9, 0x02, 0x8D, 0x07, 0x20,
+    0xA9, 0x03, 0x8D, 0x07, 0x20,
+    0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20,
+    0xA2, 0x08, 0xBD, 0xFF, 0x20, 0x85, 0x00,   // LDX #8, LDA $20FF,X, STA $00
+    0xAD, 0x07, 0x20, 0x85, 0x01,
+};
+
+// NOTE: Rendering on, MMC3 IRQ after every line, then a frame with I set so
+//       it is pending when CLI runs. The IRQ comes after the INX that
+//       follows CLI, not right after CLI.
+global_variable u8 CoreCheckIrqAfterCli[] = {
+    0xA9, 0x08, 0x8D, 0x00, 0x20,               // LDA #$08, STA $2000
+    0xA9, 0x18, 0x8D, 0x01, 0x20,               // LDA #$18, STA $2001
+    0xA9, 0x01, 0x8D, 0x00, 0xC0,               // LDA #$01, STA $C000
+    0x8D, 0x01, 0xC0, 0x8D, 0x01, 0xE0,         // STA $C001, STA $E001
+    0x2C, 0x02, 0x20, 0x10, 0xFB,               // Wait a frame
+    0x2C, 0x02, 0x20, 0x10, 0xFB,
+    0xA2, 0x00, 0x58, 0xE8, 0xE8,               // LDX #$00, CLI, INX, INX
+    0x86, 0x02,                                 // STX $02
+};
+
+// NOTE: Same setup, then CLI and SEI. CLI still polls with I set, SEI polls
+//       with I clear, so the IRQ comes right after SEI and pushes P with I
+//       set.
+global_variable u8 CoreCheckIrqAfterSei[] = {
+    0xA9, 0x08, 0x8D, 0x00, 0x20,               // LDA #$08, STA $2000
+    0xA9, 0x18, 0x8D, 0x01, 0x20,               // LDA #$18, STA $2001
+    0xA9, 0x01, 0x8D, 0x00, 0xC0,               // LDA #$01, STA $C000
+    0x8D, 0x01, 0xC0, 0x8D, 0x01, 0xE0,         // STA $C001, STA $E001
+    0x2C, 0x02, 0x20, 0x10, 0xFB,               // Wait a frame
+    0x2C, 0x02, 0x20, 0x10, 0xFB,
+    0xA2, 0x00, 0x58, 0x78, 0xE8,               // LDX #$00, CLI, SEI, INX
+    0x86, 0x02,                                 // STX $02
+};
+
+// NOTE: IRQ handler at $FFD0, stores X and the pushed P, then disables the
+//       MMC3 IRQ
+global_variable u8 CoreCheckIrqHandler[] = {
+    0x86, 0x00,                                 // STX $00
+    0xBA, 0xBD, 0x01, 0x01, 0x85, 0x01,         // TSX, LDA $0101,X, STA $01
+    0xA6, 0x00,                                 // LDX $00
+    0x8D, 0x00, 0xE0,                           // STA $E000
+    0x40,                                       // RTI
+};
+
+global_variable core_check CoreChecks[] = {
+    {"mmc1_rmw_reset", MapperMMC1, CoreCheckMmc1Reset, sizeof(CoreCheckMmc1Reset), {0x11, 0x33}, 2},
+    {"ppudata_rmw", MapperMMC1, CoreCheckPpuDataModify, sizeof(CoreCheckPpuDataModify), {0x01, 0x01, 0x02, 0x04}, 4},
+    {"store_abs_x_dummy_read", MapperMMC1, CoreCheckStoreAbsoluteX, sizeof(CoreCheckStoreAbsoluteX), {0x2A}, 1},
+    {"store_abs_y_dummy_read", MapperMMC1, CoreCheckStoreAbsoluteY, sizeof(CoreCheckStoreAbsoluteY), {0x1A}, 1},
+    {"store_ind_y_dummy_read", MapperMMC1, CoreCheckStoreIndirectY, sizeof(CoreCheckStoreIndirectY), {0x16}, 1},
+    {"load_abs_x_page_cross", MapperMMC1, CoreCheckLoadPageCross, sizeof(CoreCheckLoadPageCross), {0x02, 0x03}, 2},
+    {"irq_after_cli", MapperMMC3, CoreCheckIrqAfterCli, sizeof(CoreCheckIrqAfterCli), {0x01, 0x20, 0x02}, 3},
+    {"irq_after_sei", MapperMMC3, CoreCheckIrqAfterSei, sizeof(CoreCheckIrqAfterSei), {0x00, 0x26, 0x01}, 3},
+};
+
+// NOTE: iNES image of the check ROM, bank 3 is the fixed one at $C000 (the
+//       last two 8KB banks on MMC3)
+internal loaded_file
+CoreCheckBuildRom(core_check* Check, memory_arena* Arena) {
+    loaded_file Result = {0};
+    Result.Size = INesHeaderSize + (CoreCheckPrgBankCount * PrgBankSize);
+    Result.Data = ArenaPushArray(Arena, u8, Result.Size);
+    memset(Result.Data, 0xEA, Result.Size);
+
+    u8 Header[INesHeaderSize] = {0x4E, 0x45, 0x53, 0x1A, CoreCheckPrgBankCount, 0, (u8)(Check->MapperId << 4), 0};
+    memcpy(Result.Data, Header, INesHeaderSize);
+    u8* Prg = Result.Data + INesHeaderSize;
+    for (i32 Bank = 0; Bank < CoreCheckPrgBankCount - 1; Bank++) {
+        Prg[Bank * PrgBankSize] = (u8)(0x11 * (Bank + 1));
+    }
+
+    u8* Fixed = Prg + ((CoreCheckPrgBankCount - 1) * PrgBankSize);
+    memcpy(Fixed, CoreCheckPrelude, sizeof(CoreCheckPrelude));
+    memcpy(Fixed + sizeof(CoreCheckPrelude), Check->Code, Check->CodeSize);
+    u16 End = (u16)(0xC000 + sizeof(CoreCheckPrelude) + Check->CodeSize);
+    u8 Jump[3] = {0x4C, (u8)End, (u8)(End >> 8)};
+    memcpy(Fixed + (End - 0xC000), Jump, sizeof(Jump));
+
+    // NOTE: RTI at $FFE0 for NMI, reset at $C000
+    u8 Vectors[6] = {0xE0, 0xFF, 0x00, 0xC0, 0xD0, 0xFF};
+    memcpy(Fixed + 0x3FD0, CoreCheckIrqHandler, sizeof(CoreCheckIrqHandler));
+    Fixed[0x3FE0] = 0x40;
+    Fixed[0x3FF0] = 0xFF;
+    memcpy(Fixed + (NmiVector - 0xC000), Vectors, sizeof(Vectors));
+    return Result;
+}
+
+internal void
+CoreCheckRun(loaded_file RomFile, cpu_core CpuCore, memory_arena* Arena, u8* Ram, m6502_t* CpuResult) {
+    arena_mark Mark = ArenaMark(Arena);
+    rom Rom;
+    bool32 Parsed = ParseRom(RomFile, &Rom);
+    Assert(Parsed);
+    Unused(Parsed);
+
+    machine_state* Machine = ArenaPushStruct(Arena, machine_state);
+    chr_cache* ChrCache = ArenaPushStruct(Arena, chr_cache);
+    ChrCacheInit(ChrCache);
+    bus Bus = {0};
+    MachineInit(Machine, &Bus, &Rom);
+    Bus.ChrCache = ChrCache;
+    BusMapMemory(&Bus);
+    pixel_buffer NesScreen = {
+        NesScreenWidth,
+        NesScreenHeight,
+        ArenaPushArray(Arena, u32, NesScreenWidth * NesScreenHeight),
+    };
+    Bus.Screen = &NesScreen;
+    SchedulerInit(&Bus);
+    Bus.Scheduler.CpuCore = CpuCore;
+    if (CpuCore == CpuCoreFast) {
+        FastCpuReset(&Machine->Cpu, &Bus);
+    }
+
+    for (i32 Frame = 0; Frame < CoreCheckFrameCount; Frame++) {
+        GlobalFrame(&Machine->Cpu, &Machine->Pins, &Bus);
+    }
+    memcpy(Ram, Machine->Ram, RamSize);
+    *CpuResult = Machine->Cpu;
+    ArenaReset(Arena, Mark);
+}
+
+// NOTE: One line per check. Both cores have to store the expected bytes and
+//       end with the same RAM and registers. PC isn't compared, m6502
+//       moves it in the middle of the final JMP.
+internal bool32
+RunCoreCheck(FILE* Output) {
+    memory_arena Arena = ArenaInit(Megabytes(4));
+    u8* AccurateRam = ArenaPushArray(&Arena, u8, RamSize);
+    u8* FastRam = ArenaPushArray(&Arena, u8, RamSize);
+    bool32 Result = 1;
+
+    for (u32 CheckIndex = 0; CheckIndex < ArrayCount(CoreChecks); CheckIndex++) {
+        core_check* Check = CoreChecks + CheckIndex;
+        arena_mark Mark = ArenaMark(&Arena);
+        loaded_file RomFile = CoreCheckBuildRom(Check, &Arena);
+        m6502_t AccurateCpu;
+        m6502_t FastCpu;
+        CoreCheckRun(RomFile, CpuCoreAccurate, &Arena, AccurateRam, &AccurateCpu);
+        CoreCheckRun(RomFile, CpuCoreFast, &Arena, FastRam, &FastCpu);
+        ArenaReset(&Arena, Mark);
+
+        bool32 AccurateMatches = memcmp(AccurateRam, Check->Expected, Check->ExpectedCount) == 0;
+        bool32 FastMatches = memcmp(FastRam, Check->Expected, Check->ExpectedCount) == 0;
+        bool32 CoresMatch = memcmp(AccurateRam, FastRam, RamSize) == 0 &&
+                            AccurateCpu.A == FastCpu.A &&
+                            AccurateCpu.X == FastCpu.X && AccurateCpu.Y == FastCpu.Y &&
+                            AccurateCpu.S == FastCpu.S && AccurateCpu.P == FastCpu.P;
+        fprintf(Output, "{\"check\":\"%s\",\"accurate\":%s,\"fast\":%s,\"cores_match\":%s}\n",
+                Check->Name,
+                AccurateMatches ? "true" : "false",
+                FastMatches ? "true" : "false",
+                CoresMatch ? "true" : "false");
+        if (!AccurateMatches || !FastMatches || !CoresMatch) {
+            Result = 0;
+        }
+    }
+
+    ArenaFree(&Arena);
+    return Result;
+}
+
+int HeadlessProc(app_t* App, void* UserData) {
+    Unused(App);
+    headless_options* Options = (headless_options*)UserData;
+    PixelKernelsInit();
+    Crc32Init();
+    PixelBufferKernelsInit();
+
+    if (Options->RomDatabasePath && RomDatabaseLoad(Options->RomDatabasePath) < 0) {
+        fprintf(stderr, "Can't read ROM database '%s'\n", Options->RomDatabasePath);
+    }
+
+    if (Options->CoreCheck) {
+        return RunCoreCheck(stdout) ? 0 : 1;
+    }
+
+    if (!Options->Benchmark && !Options->KernelBenchmark) {
+        run_result Result = RunRom(Options->RomPaths[0], Options);
+        if (!Result.Loaded) {
+            return 1;
+        }
+
+        f64 Seconds = (f64)Result.Nanoseconds / 1000000000.0;
+        f64 FramesPerSecond = (Seconds > 0.0) ? (f64)Options->FrameCount / Seconds : 0.0;
+
+        printf("rom=%s frames=%d ticks=%llu seconds=%.6f fps=%.2f\n",
+               Options->RomPaths[0],
+               Options->FrameCount,
+               (unsigned long long)Result.TickCount,
+               Seconds,
+               FramesPerSecond);
+        if (Result.RunAheadFrameCount) {
+            printf("run_ahead=%d extra_ns_per_frame=%.1f\n",
+                   Result.RunAheadFrameCount,
+                   Result.RunAheadNanoseconds);
+        }
+        return 0;
+    }
+
+    FILE* Output = stdout;
+    if (Options->OutputPath) {
+        Output = fopen(Options->OutputPath, "a");
+        if (!Output) {
+            fprintf(stderr, "Can't open '%s' for writing\n", Options->OutputPath);
+            return 1;
+        }
+    }
+
+    if (Options->KernelBenchmark) {
+        RunKernelBenchmark(Output);
+    }
+
+    for (i32 RomIndex = 0; RomIndex < Options->RomCount; RomIndex++) {
+        run_result Result = RunRom(Options->RomPaths[RomIndex], Options);
+        if (!Result.Loaded) {
+            continue;
+        }
+
+        WriteBenchmarkResult(Output, Options->RomPaths[RomIndex],
+                             Options->FrameCount, Options->DebugDraw,
+                             Options->TracePath != 0, Options->Rewind,
+                             Options->CpuCore, &Result);
+        fflush(Output);
+    }
+
+    if (Output != stdout) {
+        fclose(Output);
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    headless_options Options;
+    if (!ParseOptions(argc, argv, &Options)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    return app_run(HeadlessProc, &Options, NULL, NULL, NULL);
+}
@@ -1,22 +1,30 @@
 #include "base.h"
 
+#define CHIPS_IMPL
+#include "m6502.h"
+
 #include "bus.h"
 #include "rom.h"
 #include "disassembly.h"
 #include "gfx.h"
 #include "system_font.h"
-#include "dumb_allocator.h"
+#include "arena.h"
 #include "file_io.h"
+#include "emulator.h"
+#include "save_state.h"
+#include "rewind.h"
+#include "run_ahead.h"
+#include "battery_save.h"
+#include "debug_view.h"
 
 #define APP_IMPLEMENTATION
 #define APP_WINDOWS
 #include "app.h"
 
-#define CHIPS_IMPL
-#include "m6502.h"
-
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#include <time.h>
 
 // #define RomPath ("Super Mario Bros. (JU) [!].nes")
 #define RomPath ("Donkey Kong (U) (PRG1) [!p].nes")
@@ -32,151 +40,109 @@ PlatformPrint(char* FormatString, ...) {
     printf("PLATFORM: %s\n", FormatBuffer);
 }
 
-#define ScreenScale (1)
-#define ScreenWidth (1280 / ScreenScale)
-#define ScreenHeight (720 / ScreenScale)
-
-internal void
-DrawRam(bus* Bus, pixel_buffer* Buffer, i32 CellX, i32 CellY, u8* CharBuffer) {
-    u16 Address = 0x0000;
-    i32 NumberOfColumns = 24;
-    for (i32 Row = 0; Row < 85; Row++) {
-        sprintf(CharBuffer, "%04X:\0", Address);
-        PrintToPixelBuffer(Buffer,
-                           CellX,
-                           CellY + Row,
-                           CharBuffer);
-
-        for (i32 Column = 0; Column < NumberOfColumns; Column++) {
-            u8 MemoryValue = BusRead(Bus, Address);
-
-            sprintf(CharBuffer, "%02X\0", MemoryValue);
-
-            PrintToPixelBuffer(Buffer,
-                               CellX + (Column * 2) + 5,
-                               CellY + Row,
-                               CharBuffer);
-
-            Address++;
-        }
-    }
-}
-
-internal void
-CpuTick(m6502_t* Cpu, u64* Pins, bus* Bus) {
-    *Pins = m6502_tick(Cpu, *Pins);
-    u16 Address = M6502_GET_ADDR(*Pins);
-    if (*Pins & M6502_RW) {
-        u8 MemoryValue = BusRead(Bus, Address);
-        BusPostRead(Bus, Address);
-        M6502_SET_DATA(*Pins, MemoryValue);
-    } else {
-        u8 MemoryValueToWrite = M6502_GET_DATA(*Pins);
-        BusWrite(Bus, Address, MemoryValueToWrite);
-        //TODO: Memory post-write
-    }
+u64
+PlatformTimeNanoseconds(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Counter;
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Counter);
+    return (u64)((f64)Counter.QuadPart * (1000000000.0 / (f64)Frequency.QuadPart));
+#else
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return ((u64)Time.tv_sec * 1000000000ULL) + (u64)Time.tv_nsec;
+#endif
 }
 
-internal void
-GlobalTick(m6502_t* Cpu, u64* Pins, bus* Bus,
-           ppu* Ppu, pixel_buffer* Screen) {
-    ppu_pixel Pixel = PpuGetCurrentPixel(Ppu);
-    PixelBufferPutPixel(Screen, Pixel.X, Pixel.Y, Pixel.Color);
-
-    PpuTick(Ppu);
-
-    if (Ppu->Control & NmiEnableMask) {
-        *Pins = *Pins | M6502_NMI;
-    }
-
-    if (Bus->TickCount % 3 == 0) {
-        CpuTick(Cpu, Pins, Bus);
-    }
-
-    Bus->TickCount++;
-}
+#define ScreenScale (1)
+#define ScreenWidth (DebugViewWidth / ScreenScale)
+#define ScreenHeight (DebugViewHeight / ScreenScale)
 
-internal void
-DrawCpuState(pixel_buffer* DestinationPixelBuffer,
-             i32 CellX, i32 CellY,
-             m6502_t* Cpu,
-             bus* Bus,
-             u8* CharBuffer) {
-    sprintf(CharBuffer, "Tick:%010u", Bus->TickCount);
-    PrintToPixelBuffer(DestinationPixelBuffer, CellX, CellY, CharBuffer);
-    sprintf(CharBuffer, "PC:%04X A:%02X X:%02X Y:%02X S:%02X P:%02X",
-        Cpu->PC, Cpu->A, Cpu->X, Cpu->Y, Cpu->S, Cpu->P);
-    PrintToPixelBuffer(DestinationPixelBuffer, CellX, CellY + 1, CharBuffer);
-}
+// NOTE: Play presents only the NES frame and lets app_present scale it to the
+//       window, none of the debug panels are drawn. Tab switches.
+typedef enum screen_layout {
+    ScreenLayout_Debug,
+    ScreenLayout_Play,
+} screen_layout;
 
 int AppProc(app_t* App, void* UserData) {
-    dumb_allocator Allocator = InitDumbAllocator(Megabytes(8));
-    void* RomBuffer = DumbAllocate(&Allocator, Kilobytes(128));
-    instruction_info* Instructions = DumbAllocate(&Allocator, sizeof(instruction_info) * 0x100);
-    u8* CharBuffer = DumbAllocate(&Allocator, Kilobytes(1));
-    u8** DisassemledInstructions = DumbAllocate(&Allocator, sizeof(u8*) * 0xFFFF);
-    u8* DissasemblyStringData = DumbAllocate(&Allocator, Megabytes(3));
+    PixelKernelsInit();
+    Crc32Init();
+    PixelBufferKernelsInit();
+    memory_arena Arena = ArenaInit(Megabytes(32));
+    instruction_info* Instructions = ArenaPushArray(&Arena, instruction_info, 0x100);
+    memory_arena Scratch = ArenaInit(Megabytes(1));
+    disassembler* Disassembler = ArenaPushStruct(&Arena, disassembler);
 
     InitInstructionsDictionary(Instructions);
 
-    loaded_file RomFile = LoadFile(RomPath, RomBuffer);
-
-    Assert(RomFile.Data[0] == 0x4E);
-    Assert(RomFile.Data[1] == 0x45);
-    Assert(RomFile.Data[2] == 0x53);
-    Assert(RomFile.Data[3] == 0x1A);
+    // NOTE: Mapped for the whole run, Rom.Prg and Rom.Chr point into it
+    loaded_file RomFile = MapFile(RomPath);
+    rom Rom;
+    if (!ParseRom(RomFile, &Rom)) {
+        PlatformPrint("Can't load ROM '%s'", RomPath);
+        return 1;
+    }
 
-    u8* Ram = DumbAllocate(&Allocator, Kilobytes(2));
-    ppu Ppu = PpuInit();
-    rom Rom = ParseRom(RomFile);
+    machine_state* Machine = ArenaPushStruct(&Arena, machine_state);
+    chr_cache* ChrCache = ArenaPushStruct(&Arena, chr_cache);
+    ChrCacheInit(ChrCache);
     bus Bus = {0};
-    Bus.Rom = &Rom;
-    Bus.Ram = Ram;
-    Bus.Ppu = &Ppu;
-
-    Dissasemble(&Bus,
-                Instructions,
-                DisassemledInstructions,
-                DissasemblyStringData);
-
-    m6502_t Cpu;
-    m6502_desc_t CpuDesc = {0};
-    uint64_t Pins = m6502_init(&Cpu, &CpuDesc);
+    MachineInit(Machine, &Bus, &Rom);
+    Bus.ChrCache = ChrCache;
+    Bus.CodeDataLog = ArenaPushArray(&Arena, u8, CodeDataLogSize(&Rom));
+    memset(Bus.CodeDataLog, 0, CodeDataLogSize(&Rom));
+    battery_save Battery;
+    if (!BatterySaveOpen(&Battery, RomPath, &Bus)) {
+        PlatformPrint("Can't map the .sav file, PRG-RAM won't be kept");
+    }
+    BusMapMemory(&Bus);
+
+    m6502_t* Cpu = &Machine->Cpu;
+    u64* Pins = &Machine->Pins;
+    save_state* QuickSave = ArenaPushStruct(&Arena, save_state);
+    bool32 HasQuickSave = 0;
+    rewind_buffer Rewind;
+    RewindInit(&Rewind, &Arena,
+               RewindDefaultArenaSize, RewindDefaultEntryCount, RewindDefaultKeyframeInterval);
+    run_ahead RunAhead;
+    RunAheadInit(&RunAhead, &Arena, RunAheadMaxFrameCount);
+    RunAhead.FrameCount = 0;
 
     pixel_buffer Screen = {
         ScreenWidth,
         ScreenHeight,
-        (u32*)DumbAllocate(&Allocator, sizeof(u32) * ScreenWidth * ScreenHeight),
+        ArenaPushArray(&Arena, u32, ScreenWidth * ScreenHeight),
     };
 
     pixel_buffer NesScreen = {
         NesScreenWidth,
         NesScreenHeight,
-        (u32*)DumbAllocate(&Allocator, sizeof(u32) * NesScreenWidth * NesScreenHeight),
+        ArenaPushArray(&Arena, u32, NesScreenWidth * NesScreenHeight),
     };
 
-    pixel_buffer NameTableVisual0 = {
-        16,
-        16,
-        (u32*)Ppu.NameTable[0],
-    };
+    debug_views* Views = ArenaPushStruct(&Arena, debug_views);
+    DebugViewsInit(Views, &Arena);
 
-    pixel_buffer NameTableVisual1 = {
-        16,
-        16,
-        (u32*)Ppu.NameTable[1],
-    };
+    Bus.Screen = &NesScreen;
+    SchedulerInit(&Bus);
+
+    DisassemblerInit(Disassembler, &Bus, Instructions);
 
     // app_interpolation(App, APP_INTERPOLATION_NONE);
     app_screenmode(App, APP_SCREENMODE_WINDOW);
 
-    //TODO: Fix disassembled code rendering during CPU startup
     bool32 Animate = 1;
+    bool32 Rewinding = 0;
+    screen_layout Layout = ScreenLayout_Debug;
 
     f32 AppTimeFrequency = app_time_freq(App);
+    f32 FrameDelta = 0.0f;
 
     while(app_yield(App) != APP_STATE_EXIT_REQUESTED) {
         u64 AppTimeFrameStart = app_time_count(App);
+        ArenaBeginFrame(&Scratch);
         bool32 DoOneTick = 0;
         bool32 DoOneInstruction = 0;
         bool32 DoOneFrame = 0;
@@ -186,6 +152,18 @@ int AppProc(app_t* App, void* UserData) {
                 if (Input.events[InputIndex].data.key == APP_KEY_SPACE) {
                     Animate = !Animate;
                 }
+                if (Input.events[InputIndex].data.key == APP_KEY_TAB) {
+                    // NOTE: Whole pixel scaling keeps the NES frame sharp, the
+                    //       debug screen goes back to the default filtering
+                    if (Layout == ScreenLayout_Debug) {
+                        Layout = ScreenLayout_Play;
+                        app_interpolation(App, APP_INTERPOLATION_NONE);
+                    } else {
+                        Layout = ScreenLayout_Debug;
+                        app_interpolation(App, APP_INTERPOLATION_LINEAR);
+                        DebugViewsInvalidate(Views);
+                    }
+                }
                 if (Input.events[InputIndex].data.key == APP_KEY_S) {
                     DoOneTick = 1;
                 }
@@ -195,99 +173,81 @@ int AppProc(app_t* App, void* UserData) {
                 if (Input.events[InputIndex].data.key == APP_KEY_F) {
                     DoOneFrame = 1;
                 }
+                if (Input.events[InputIndex].data.key == APP_KEY_F5) {
+                    SaveStateCapture(QuickSave, Machine, &Bus);
+                    HasQuickSave = 1;
+                }
+                if (Input.events[InputIndex].data.key == APP_KEY_F9 && HasQuickSave) {
+                    SaveStateRestore(QuickSave, Machine, &Bus);
+                }
+                if (Input.events[InputIndex].data.key == APP_KEY_R) {
+                    Rewinding = 1;
+                }
+                if (Input.events[InputIndex].data.key == APP_KEY_UP) {
+                    MemoryViewScroll(&Views->Memory, -1);
+                }
+                if (Input.events[InputIndex].data.key == APP_KEY_DOWN) {
+                    MemoryViewScroll(&Views->Memory, 1);
+                }
+                if (Input.events[InputIndex].data.key == APP_KEY_PRIOR) {
+                    MemoryViewScroll(&Views->Memory, -MemoryViewRowCount);
+                }
+                if (Input.events[InputIndex].data.key == APP_KEY_NEXT) {
+                    MemoryViewScroll(&Views->Memory, MemoryViewRowCount);
+                }
+                if (Input.events[InputIndex].data.key == APP_KEY_A) {
+                    RunAhead.FrameCount = (RunAhead.FrameCount + 1) % (RunAheadMaxFrameCount + 1);
+                    PlatformPrint("Run-ahead: %d frames", RunAhead.FrameCount);
+                }
+            }
+            if (Input.events[InputIndex].type == APP_INPUT_KEY_UP) {
+                if (Input.events[InputIndex].data.key == APP_KEY_R) {
+                    Rewinding = 0;
+                }
             }
         }
 
-        if (Animate) {
-            do {
-                GlobalTick(&Cpu, &Pins, &Bus,
-                           &Ppu, &NesScreen);
-            } while (!Ppu.FrameComplete);
-            Ppu.FrameComplete = 0;
+        if (Rewinding) {
+            // NOTE: Screen keeps the last frame drawn, the rewound frame shows up
+            //       once emulation goes forward again
+            RewindStep(&Rewind, Machine, &Bus);
+        } else if (Animate) {
+            RunAheadFrame(&RunAhead, Machine, &Bus);
+            RewindCapture(&Rewind, Machine, &Bus);
         } else if (DoOneTick) {
-            GlobalTick(&Cpu, &Pins, &Bus,
-                       &Ppu, &NesScreen);
+            GlobalTick(Cpu, Pins, &Bus);
         } else if (DoOneInstruction) {
-            u16 SavedPC = Cpu.PC;
-            do {
-                GlobalTick(&Cpu, &Pins, &Bus,
-                           &Ppu, &NesScreen);
-            } while (Cpu.PC == SavedPC);
-            // TODO: Cpu.PC change doesn't mean that Cpu is on the next instruction
-            //       We also need to validate that this instruction is inside
-            //       DisassemledInstructions. But looks like this aproach doesn't work
-            //       properly.
-            while (!DisassemledInstructions[Cpu.PC]) {
-                GlobalTick(&Cpu, &Pins, &Bus,
-                           &Ppu, &NesScreen);
+            // NOTE: SYNC is up while an opcode is fetched, leave the current
+            //       fetch behind first and stop on the next one
+            while (*Pins & M6502_SYNC) {
+                GlobalTick(Cpu, Pins, &Bus);
+            }
+            while (!(*Pins & M6502_SYNC)) {
+                GlobalTick(Cpu, Pins, &Bus);
             }
-
         } else if (DoOneFrame) {
-            do {
-                GlobalTick(&Cpu, &Pins, &Bus,
-                           &Ppu, &NesScreen);
-            } while (!Ppu.FrameComplete);
-            Ppu.FrameComplete = 0;
-        }
-
-        PixelBufferClear(&Screen, 0xFF000000);
-
-        DrawCpuState(&Screen, 1, 1, &Cpu, &Bus, CharBuffer);
-        DrawCode(&Screen, 1, 4, Cpu.PC, &Bus, DisassemledInstructions);
-        DrawRam(&Bus, &Screen, 1, 12, CharBuffer);
-
-        {
-            sprintf(CharBuffer, "S: %04d, D: %03d, CTRL: %02X, STATUS: %02X, OAMADDR: %04X (%04X)",
-                Ppu.Scanline, Ppu.Dot,
-                Ppu.Control,
-                PpuPackStatus(&Ppu),
-                Ppu.Oam.Address,
-                Ppu.Oam.TempAddress);
-            PrintToPixelBuffer(&Screen, 1, 3, CharBuffer);
+            GlobalFrame(Cpu, Pins, &Bus);
         }
 
-        // u8 Control;
-        // status_register Status;
-        // oam Oam;
+        BatterySaveUpdate(&Battery);
 
-        PixelBufferBlit(&Screen, &NesScreen, 8 * 54, 8 * 1);
-
-        PixelBufferBlit(&Screen, &NameTableVisual0, 8 * 80, 8 * 1);
-        PixelBufferBlit(&Screen, &NameTableVisual1, 8 * 80, 8 * 4);
-
-        {
-            i32 PatternTablesX = 8 * 54;
-            i32 PatternTablesY = 8 * 40;
-
-            //TODO: Better name for PatternsPerColum
-            for (i32 Row = 0; Row < PatternsPerColum; Row++) {
-                for (i32 Column = 0; Column < PatternsPerColum; Column++) {
-                    for (i32 PixelOffsetY = 0; PixelOffsetY < PatternSizeInPixels; PixelOffsetY++) {
-                        for (i32 PixelOffsetX = 0; PixelOffsetX < PatternSizeInPixels; PixelOffsetX++) {
-                            {
-                                i32 DestX = PatternTablesX + (Column * PatternSizeInPixels) + PixelOffsetX;
-                                i32 DestY = PatternTablesY + (Row * PatternSizeInPixels) + PixelOffsetY;
-                                u32 DestColor = PpuGetTilePixel(&Bus, Left, Row, Column, PixelOffsetX, PixelOffsetY);
-                                PixelBufferPutPixel(&Screen, DestX, DestY, DestColor);
-                            }
-                            {
-                                i32 DestX = PatternTablesX + (Column * PatternSizeInPixels) + PixelOffsetX + 128;
-                                i32 DestY = PatternTablesY + (Row * PatternSizeInPixels) + PixelOffsetY;
-                                u32 DestColor = PpuGetTilePixel(&Bus, Right, Row, Column, PixelOffsetX, PixelOffsetY);
-                                PixelBufferPutPixel(&Screen, DestX, DestY, DestColor);
-                            }
-                        }
-                    }
-                }
-            }
+        if (Layout == ScreenLayout_Play) {
+            app_present(App, NesScreen.Memory, NesScreenWidth, NesScreenHeight, 0xFFFFFF, 0x000000);
+        } else {
+            DrawDebugView(&Screen, &NesScreen, Views,
+                          Cpu, &Bus,
+                          Disassembler,
+                          FrameDelta,
+                          PlatformTimeNanoseconds(),
+                          &Scratch);
 
+            app_present(App, Screen.Memory, ScreenWidth, ScreenHeight, 0xFFFFFF, 0x220000);
         }
-
-        app_present(App, Screen.Memory, ScreenWidth, ScreenHeight, 0xFFFFFF, 0x220000);
         u64 AppTimeFrameEnd = app_time_count(App);
-        f32 FrameDelta = (f32)(AppTimeFrameEnd - AppTimeFrameStart) / AppTimeFrequency;
+        FrameDelta = (f32)(AppTimeFrameEnd - AppTimeFrameStart) / AppTimeFrequency;
         //DumpFloatExpression(FrameDelta);
     }
+    BatterySaveClose(&Battery, Machine, &Bus);
     return 0;
 }
 
@@ -0,0 +1,141 @@
+#include "base.h"
+
+#define CHIPS_IMPL
+#include "m6502.h"
+
+#include "bus.h"
+#include "ppu.h"
+#include "disassembly.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+// NOTE: Offline formatter for binary traces written with `emulator_headless
+//       -trace`. Prints one nestest-style line per record, so traces can be
+//       diffed against reference logs.
+
+void
+PlatformPrint(char* FormatString, ...) {
+    char FormatBuffer[Kilobytes(1)];
+    va_list Arguments;
+    va_start(Arguments, FormatString);
+    vsprintf(FormatBuffer, FormatString, Arguments);
+    va_end(Arguments);
+    fprintf(stderr, "PLATFORM: %s\n", FormatBuffer);
+}
+
+u64
+PlatformTimeNanoseconds(void) {
+    return 0;
+}
+
+internal void
+FormatTraceOperand(char* Buffer, trace_record* Record, instruction_info* Info) {
+    u8 Low = Record->Operand[0];
+    u16 Word = (u16)(Record->Operand[0] | (Record->Operand[1] << 8));
+    switch (Info->AddressingMode) {
+        case Implicit   : Buffer[0] = 0; break;
+        case Accumulator: sprintf(Buffer, "A"); break;
+        case Immediate  : sprintf(Buffer, "#$%02X", Low); break;
+        case ZeroPage   : sprintf(Buffer, "$%02X", Low); break;
+        case ZeroPageX  : sprintf(Buffer, "$%02X,X", Low); break;
+        case ZeroPageY  : sprintf(Buffer, "$%02X,Y", Low); break;
+        case Relative   : sprintf(Buffer, "$%04X", (u16)(Record->PC + 2 + (i8)Low)); break;
+        case Absolute   : sprintf(Buffer, "$%04X", Word); break;
+        case AbsoluteX  : sprintf(Buffer, "$%04X,X", Word); break;
+        case AbsoluteY  : sprintf(Buffer, "$%04X,Y", Word); break;
+        case Indirect   : sprintf(Buffer, "($%04X)", Word); break;
+        case IndirectX  : sprintf(Buffer, "($%02X,X)", Low); break;
+        case IndirectY  : sprintf(Buffer, "($%02X),Y", Low); break;
+        default         : Buffer[0] = 0; break;
+    }
+}
+
+internal void
+PrintTraceRecord(FILE* Output, trace_record* Record, instruction_info* InstructionsDict) {
+    instruction_info* Info = InstructionsDict + Record->OpCode;
+    i32 Size = AddressingModeToSize(Info->AddressingMode);
+
+    char Bytes[16];
+    if (Size == 3) {
+        sprintf(Bytes, "%02X %02X %02X", Record->OpCode, Record->Operand[0], Record->Operand[1]);
+    } else if (Size == 2) {
+        sprintf(Bytes, "%02X %02X", Record->OpCode, Record->Operand[0]);
+    } else {
+        sprintf(Bytes, "%02X", Record->OpCode);
+    }
+
+    char Operand[16];
+    FormatTraceOperand(Operand, Record, Info);
+
+    // NOTE: PPU starts at -1:0 on clock 0 and every frame has the same length
+    u64 FrameDot = Record->MasterClock % PpuFrameDotCount;
+    i32 Scanline = (i32)(FrameDot / PpuDotPerScanline) - 1;
+    i32 Dot = (i32)(FrameDot % PpuDotPerScanline);
+
+    fprintf(Output, "%04X  %-8s %c%s %-27s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu\n",
+            Record->PC,
+            Bytes,
+            Info->Unofficial ? '*' : ' ',
+            MnemonicToString(Info->Mnemonic),
+            Operand,
+            Record->A, Record->X, Record->Y, Record->P, Record->S,
+            Scanline, Dot,
+            (unsigned long long)(Record->MasterClock / CpuClockDivider));
+}
+
+int
+main(int ArgumentCount, char** Arguments) {
+    if (ArgumentCount < 2 || ArgumentCount > 3) {
+        fprintf(stderr, "Usage: %s <trace.bin> [out.txt]\n", Arguments[0]);
+        return 1;
+    }
+
+    FILE* Input = fopen(Arguments[1], "rb");
+    if (!Input) {
+        fprintf(stderr, "Can't open '%s'\n", Arguments[1]);
+        return 1;
+    }
+
+    trace_file_header Header;
+    if (fread(&Header, sizeof(Header), 1, Input) != 1 ||
+        Header.Magic != TraceFileMagic ||
+        Header.Version != TraceFileVersion ||
+        Header.RecordSize != sizeof(trace_record)) {
+        fprintf(stderr, "'%s' is not a version %d trace\n", Arguments[1], TraceFileVersion);
+        fclose(Input);
+        return 1;
+    }
+
+    FILE* Output = stdout;
+    if (ArgumentCount == 3) {
+        Output = fopen(Arguments[2], "w");
+        if (!Output) {
+            fprintf(stderr, "Can't open '%s' for writing\n", Arguments[2]);
+            fclose(Input);
+            return 1;
+        }
+    }
+
+    instruction_info InstructionsDict[0x100];
+    memset(InstructionsDict, 0, sizeof(InstructionsDict));
+    InitInstructionsDictionary(InstructionsDict);
+
+    trace_record Records[1024];
+    size_t RecordCount;
+    while ((RecordCount = fread(Records, sizeof(trace_record), ArrayCount(Records), Input)) > 0) {
+        for (size_t RecordIndex = 0; RecordIndex < RecordCount; RecordIndex++) {
+            PrintTraceRecord(Output, Records + RecordIndex, InstructionsDict);
+        }
+    }
+
+    fclose(Input);
+    if (Output != stdout) {
+        fclose(Output);
+    }
+
+    return 0;
+}